@@ -0,0 +1,260 @@
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+#include "predictor.h"
+#include "engine.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Throughput of the simulator itself, per trace:
+//
+//   decode      every record, then conditional branches only
+//   predictor   lookup + update of each predictor over the trace's
+//               conditional branches, held in memory so that decode
+//               does not count
+//   end-to-end  an engine running the -e list, as predictor would
+//
+// Each measurement is repeated -reps times and the fastest kept. One
+// CSV (or JSON) row per measurement; compare them across builds.
+
+#define BENCH_DEFAULT_END_TO_END "2bitsat,2level,openend"
+
+struct BENCH_RESULT{
+  string stage;
+  string name;
+  string trace;
+  UINT64 items;          // records for decode and end-to-end, branches otherwise
+  double seconds;        // best of the repetitions
+};
+
+static double now(){
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static string traceName(const string &path){
+  size_t slash = path.find_last_of('/');
+  return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+static void benchDecode(const string &trace, bool condOnly, int reps, vector<BENCH_RESULT> *out){
+  BENCH_RESULT r = { "decode", condOnly ? "conditional" : "all", traceName(trace), 0, 0 };
+
+  for (int i = 0; i < reps; i++) {
+    CBP_TRACE_READER *tracer = OpenTraceReader((char *) trace.c_str(), condOnly);
+    CBP_TRACE_RECORD  rec;
+    UINT64            n = 0;
+    double            start = now();
+
+    tracer->SetHeartBeat(false);
+    while (tracer->GetNextRecord(&rec)) {
+      n++;
+    }
+
+    double t = now() - start;
+    if (i == 0 || t < r.seconds) {
+      r.seconds = t;
+    }
+    r.items = condOnly ? n : tracer->GetNumInst();
+    delete tracer;
+  }
+  out->push_back(r);
+}
+
+static void benchPredictor(const string &trace, const string &name, const vector<CBP_TRACE_RECORD> &branches,
+                           int reps, vector<BENCH_RESULT> *out){
+  BENCH_RESULT   r = { "predictor", name, traceName(trace), branches.size(), 0 };
+  CBP_PREDICTOR *p = CreatePredictor(name.c_str());
+
+  for (int i = 0; i < reps; i++) {
+    UINT64 wrong[CBP_MAX_LANES] = {0};
+    double start;
+
+    p->Init();
+    start = now();
+    for (size_t b = 0; b < branches.size(); b += CBP_ENGINE_BATCH) {
+      p->RunBatch(&branches[b], min((size_t) CBP_ENGINE_BATCH, branches.size() - b), wrong);
+    }
+
+    double t = now() - start;
+    if (i == 0 || t < r.seconds) {
+      r.seconds = t;
+    }
+  }
+  delete p;
+  out->push_back(r);
+}
+
+static void benchEndToEnd(const string &trace, const vector<string> &names, const string &list,
+                          int reps, vector<BENCH_RESULT> *out){
+  BENCH_RESULT r = { "end-to-end", list, traceName(trace), 0, 0 };
+
+  // keep the CSV row intact
+  replace(r.name.begin(), r.name.end(), ',', '+');
+
+  for (int i = 0; i < reps; i++) {
+    double     start = now();
+    CBP_ENGINE engine;
+
+    for (size_t k = 0; k < names.size(); k++) {
+      engine.AddPredictor(names[k].c_str());
+    }
+    CBP_TRACE_READER *tracer = OpenTraceReader((char *) trace.c_str(), true);
+    tracer->SetHeartBeat(false);
+    engine.Run(tracer);
+
+    double t = now() - start;
+    if (i == 0 || t < r.seconds) {
+      r.seconds = t;
+    }
+    r.items = tracer->GetNumInst();
+    delete tracer;
+  }
+  out->push_back(r);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+static vector<string> splitList(const char *list){
+  vector<string> names;
+  string         all = list;
+  size_t         pos = 0, comma;
+
+  do {
+    comma = all.find(',', pos);
+    string name = all.substr(pos, comma == string::npos ? string::npos : comma - pos);
+    CBP_PREDICTOR *p = CreatePredictor(name.c_str());
+
+    if (p == NULL) {
+      printf("unknown predictor '%s'. Dying\n", name.c_str());
+      exit(-1);
+    }
+    delete p;
+    names.push_back(name);
+    pos = comma + 1;
+  } while (comma != string::npos);
+  return names;
+}
+
+static void writeCSV(FILE *out, const vector<BENCH_RESULT> &results){
+  fprintf(out, "stage,name,trace,items,seconds,items_per_second,ns_per_item\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BENCH_RESULT &r = results[i];
+    fprintf(out, "%s,%s,%s,%llu,%.6f,%.0f,%.2f\n", r.stage.c_str(), r.name.c_str(), r.trace.c_str(),
+            r.items, r.seconds, r.items / r.seconds, 1e9 * r.seconds / r.items);
+  }
+}
+
+static void writeJSON(FILE *out, const vector<BENCH_RESULT> &results){
+  fprintf(out, "[\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BENCH_RESULT &r = results[i];
+    fprintf(out, "  { \"stage\": \"%s\", \"name\": \"%s\", \"trace\": \"%s\", \"items\": %llu,"
+            " \"seconds\": %.6f, \"items_per_second\": %.0f, \"ns_per_item\": %.2f }%s\n",
+            r.stage.c_str(), r.name.c_str(), r.trace.c_str(), r.items, r.seconds,
+            r.items / r.seconds, 1e9 * r.seconds / r.items, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "]\n");
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// usage: bench [-p <name>[,<name>...]] [-e <name>[,<name>...]] [-reps <n>] [-json] [-o <file>] <trace>...
+//
+// -p picks the predictors timed one by one (default: every registered
+// one), -e the list run end to end (default: predictor's own default).
+
+int main(int argc, char* argv[]){
+  const char    *predictorList = NULL;
+  const char    *endToEndList = BENCH_DEFAULT_END_TO_END;
+  int            reps = 3;
+  bool           json = false;
+  const char    *outFile = NULL;
+  vector<string> traces;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      predictorList = argv[++i];
+    } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      endToEndList = argv[++i];
+    } else if (strcmp(argv[i], "-reps") == 0 && i + 1 < argc) {
+      reps = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outFile = argv[++i];
+    } else if (argv[i][0] != '-') {
+      traces.push_back(argv[i]);
+    } else {
+      traces.clear();
+      break;
+    }
+  }
+
+  if (traces.empty() || reps < 1) {
+    printf("usage: %s [-p <name>[,<name>...]] [-e <name>[,<name>...]] [-reps <n>] [-json] [-o <file>] <trace>...\n", argv[0]);
+    exit(-1);
+  }
+
+  vector<string> predictors;
+  if (predictorList != NULL) {
+    predictors = splitList(predictorList);
+  } else {
+    for (int i = 0; i < NumRegisteredPredictors(); i++) {
+      predictors.push_back(GetRegisteredPredictor(i)->name);
+    }
+  }
+  vector<string> endToEnd = splitList(endToEndList);
+
+  vector<BENCH_RESULT> results;
+
+  for (size_t t = 0; t < traces.size(); t++) {
+    benchDecode(traces[t], false, reps, &results);
+    benchDecode(traces[t], true, reps, &results);
+
+    // decode once, then time the predictors on the branches alone
+    vector<CBP_TRACE_RECORD> branches;
+    CBP_TRACE_READER        *tracer = OpenTraceReader((char *) traces[t].c_str(), true);
+    CBP_TRACE_RECORD         rec;
+
+    tracer->SetHeartBeat(false);
+    while (tracer->GetNextRecord(&rec)) {
+      if (rec.opType == OPTYPE_BRANCH_COND) {
+        branches.push_back(rec);
+      }
+    }
+    delete tracer;
+
+    if (branches.empty()) {
+      printf("%s has no conditional branches. Dying\n", traces[t].c_str());
+      exit(-1);
+    }
+    for (size_t k = 0; k < predictors.size(); k++) {
+      benchPredictor(traces[t], predictors[k], branches, reps, &results);
+    }
+
+    benchEndToEnd(traces[t], endToEnd, endToEndList, reps, &results);
+  }
+
+  FILE *out = stdout;
+  if (outFile != NULL && (out = fopen(outFile, "w")) == NULL) {
+    printf("Unable to create %s. Dying\n", outFile);
+    exit(-1);
+  }
+  if (json) {
+    writeJSON(out, results);
+  } else {
+    writeCSV(out, results);
+  }
+  if (out != stdout) {
+    fclose(out);
+  }
+}
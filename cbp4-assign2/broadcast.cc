@@ -0,0 +1,96 @@
+#include <thread>
+#include "broadcast.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_TRACE_BROADCAST::CBP_TRACE_BROADCAST(int numConsumers)
+  : released(numConsumers){
+
+  slots = new CBP_TRACE_BATCH[CBP_BATCH_SLOTS];
+  published.seq = 0;
+  finished = false;
+
+  for (int c = 0; c < numConsumers; c++) {
+    released[c].seq = 0;
+  }
+
+  numInst = 0;
+  numCondBranch = 0;
+}
+
+CBP_TRACE_BROADCAST::~CBP_TRACE_BROADCAST(){
+  delete [] slots;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_TRACE_BROADCAST::Produce(CBP_TRACE_READER *tracer){
+  UINT64 seq;
+
+  for (seq = 0; ; seq++) {
+
+    // wait for the slowest consumer to free the slot
+    while (true) {
+      UINT64 oldest = seq;
+      for (size_t c = 0; c < released.size(); c++) {
+        UINT64 r = released[c].seq.load(std::memory_order_acquire);
+        if (r < oldest) {
+          oldest = r;
+        }
+      }
+      if (seq - oldest < CBP_BATCH_SLOTS) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+
+    CBP_TRACE_BATCH *b = &slots[seq % CBP_BATCH_SLOTS];
+    b->count = 0;
+    while (b->count < CBP_BATCH_RECORDS && tracer->GetNextRecord(&b->rec[b->count])) {
+      b->count++;
+    }
+    b->numInst = tracer->GetNumInst();
+
+    if (b->count == 0) {
+      break;
+    }
+    published.seq.store(seq + 1, std::memory_order_release);
+
+    if (b->count < CBP_BATCH_RECORDS) {
+      break;
+    }
+  }
+
+  numInst = tracer->GetNumInst();
+  numCondBranch = tracer->GetNumCondBranch();
+  finished.store(true, std::memory_order_release);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+const CBP_TRACE_BATCH *CBP_TRACE_BROADCAST::Acquire(int consumer, UINT64 seq){
+  while (true) {
+    if (seq < published.seq.load(std::memory_order_acquire)) {
+      return &slots[seq % CBP_BATCH_SLOTS];
+    }
+
+    // published is re-read after finished so a last batch is not missed
+    if (finished.load(std::memory_order_acquire)) {
+      if (seq < published.seq.load(std::memory_order_acquire)) {
+        return &slots[seq % CBP_BATCH_SLOTS];
+      }
+      return NULL;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void CBP_TRACE_BROADCAST::Release(int consumer){
+  released[consumer].seq.fetch_add(1, std::memory_order_release);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
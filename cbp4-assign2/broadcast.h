@@ -0,0 +1,65 @@
+#ifndef _BROADCAST_H_
+#define _BROADCAST_H_
+
+#include <atomic>
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+#define CBP_BATCH_RECORDS   4096   // records per batch
+#define CBP_BATCH_SLOTS     16     // batches in flight
+
+// A batch is written once by the producer and then only read.
+
+struct CBP_TRACE_BATCH{
+  CBP_TRACE_RECORD rec[CBP_BATCH_RECORDS];
+  int              count;
+  UINT64           numInst;        // trace position after the last record
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// One producer decodes a trace into a ring of batches. Any number of
+// consumers read every batch in order. The ring is lock-free: the
+// producer publishes a batch sequence number, and each consumer
+// publishes how many batches it has released. A slot is refilled only
+// after the slowest consumer has released it.
+
+class CBP_TRACE_BROADCAST{
+ private:
+  // each counter sits on its own cache line so consumers do not false-share
+  struct CURSOR{
+    std::atomic<UINT64> seq;
+    char                pad[64 - sizeof(std::atomic<UINT64>)];
+  };
+
+  CBP_TRACE_BATCH    *slots;
+  CURSOR              published;   // batches produced
+  std::atomic<bool>   finished;    // no batch after published
+  std::vector<CURSOR> released;    // batches released, per consumer
+
+  UINT64              numInst;
+  UINT64              numCondBranch;
+
+ public:
+  CBP_TRACE_BROADCAST(int numConsumers);
+  ~CBP_TRACE_BROADCAST();
+
+  // producer: decodes the whole trace, blocking while the ring is full
+  void Produce(CBP_TRACE_READER *tracer);
+
+  // consumer: batch number seq, or NULL at the end of the trace.
+  // The batch stays valid until Release(consumer) is called.
+  const CBP_TRACE_BATCH *Acquire(int consumer, UINT64 seq);
+  void Release(int consumer);
+
+  // trace totals, valid once Acquire has returned NULL
+  UINT64 GetNumInst(){ return numInst; }
+  UINT64 GetNumCondBranch(){ return numCondBranch; }
+};
+
+#endif // _BROADCAST_H_
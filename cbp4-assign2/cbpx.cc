@@ -0,0 +1,249 @@
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cbpx.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBPX_TRACER::CBPX_TRACER(char *traceFileName, bool condOnly){
+  struct stat st;
+  int fd;
+
+  if ((fd = open(traceFileName, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+   printf("Unable to open the trace file. Dying\n");
+   exit(-1);
+  }
+
+  mapBytes = st.st_size;
+  map = (unsigned char *) mmap(NULL, mapBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED || mapBytes < sizeof(CBPX_HEADER)){
+   printf("Unable to map the trace file. Dying\n");
+   exit(-1);
+  }
+  madvise(map, mapBytes, MADV_SEQUENTIAL);
+
+  hdr = (const CBPX_HEADER *) map;
+  if (hdr->version != CBPX_VERSION || hdr->fileBytes != mapBytes){
+   printf("Bad .cbpx header in %s. Dying\n", traceFileName);
+   exit(-1);
+  }
+
+  pc          = (const UINT32 *) (map + hdr->pcOffset);
+  target      = (const UINT32 *) (map + hdr->targetOffset);
+  opType      = (const UINT8  *) (map + hdr->opTypeOffset);
+  taken       = (const UINT8  *) (map + hdr->takenOffset);
+  pcDelta     = map + hdr->pcOffset;
+  targetDelta = map + hdr->targetOffset;
+  lastPC      = 0;
+  lastTarget  = 0;
+
+  condIndex   = (const UINT64 *) (map + hdr->condIndexOffset);
+  condPC      = (const UINT32 *) (map + hdr->condPCOffset);
+  condTarget  = (const UINT32 *) (map + hdr->condTargetOffset);
+  condTaken   = (const UINT8  *) (map + hdr->condTakenOffset);
+
+  cursor = 0;
+  this->condOnly = condOnly;
+}
+
+CBPX_TRACER::~CBPX_TRACER(){
+  munmap(map, mapBytes);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+bool  CBPX_TRACER::GetNextRecord(CBP_TRACE_RECORD *rec){
+
+  // conditional-only runs walk the branch index and jump the counts
+  if (condOnly) {
+    if (cursor == hdr->numCondBranch) {
+      numInst = hdr->numInst;
+      return FAILURE;
+    }
+
+    rec->PC           = condPC[cursor];
+    rec->branchTarget = condTarget[cursor];
+    rec->branchTaken  = condTaken[cursor];
+    rec->opType       = OPTYPE_BRANCH_COND;
+
+    numInst = condIndex[cursor] + 1;
+    numCondBranch++;
+    cursor++;
+    CheckHeartBeat();
+
+    return SUCCESS;
+  }
+
+  if (cursor == hdr->numInst) {
+    return FAILURE;
+  }
+
+  if (hdr->flags & CBPX_FLAG_DELTA) {
+    lastPC     += CbpxUnZigZag(CbpxGetVarint(&pcDelta));
+    lastTarget += CbpxUnZigZag(CbpxGetVarint(&targetDelta));
+    rec->PC           = lastPC;
+    rec->branchTarget = lastTarget;
+  } else {
+    rec->PC           = pc[cursor];
+    rec->branchTarget = target[cursor];
+  }
+  rec->opType      = (OpType) opType[cursor];
+  rec->branchTaken = taken[cursor];
+  cursor++;
+
+  // sanity check
+  assert(rec->opType < OPTYPE_MAX);
+
+  numInst++;
+  CheckHeartBeat();
+
+  if(rec->opType == OPTYPE_BRANCH_COND){
+    numCondBranch++;
+  }
+
+  return SUCCESS;
+}
+
+// The branch index gives the conditional branch count directly; only
+// delta-encoded streams have to be walked to keep lastPC/lastTarget.
+
+void  CBPX_TRACER::SkipTo(UINT64 inst){
+  if (inst > hdr->numInst) {
+    inst = hdr->numInst;
+  }
+  if (inst <= numInst) {
+    return;
+  }
+
+  UINT64 cond = lower_bound(condIndex, condIndex + hdr->numCondBranch, inst) - condIndex;
+
+  if (condOnly) {
+    cursor = cond;
+  } else if (hdr->flags & CBPX_FLAG_DELTA) {
+    while (cursor < inst) {
+      lastPC     += CbpxUnZigZag(CbpxGetVarint(&pcDelta));
+      lastTarget += CbpxUnZigZag(CbpxGetVarint(&targetDelta));
+      cursor++;
+    }
+  } else {
+    cursor = inst;
+  }
+
+  numInst = inst;
+  numCondBranch = cond;
+  lastHeartBeat = numInst;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Appends a staged stream to the output at the next 8-byte boundary and
+// returns the offset it landed at.
+
+static UINT64 AppendStream(FILE *out, FILE *stream){
+  static const char pad[8] = {0};
+  char   buf[1 << 16];
+  size_t got;
+  UINT64 offset = ftell(out);
+
+  if (offset & 7) {
+    fwrite(pad, 1, 8 - (offset & 7), out);
+    offset = (offset + 7) & ~7ULL;
+  }
+
+  rewind(stream);
+  while ((got = fread(buf, 1, sizeof(buf), stream)) > 0) {
+    fwrite(buf, 1, got, out);
+  }
+  fclose(stream);
+
+  return offset;
+}
+
+UINT64 ConvertToCbpx(char *inFileName, char *outFileName, bool delta){
+  enum { S_PC, S_TARGET, S_OPTYPE, S_TAKEN,
+         S_COND_INDEX, S_COND_PC, S_COND_TARGET, S_COND_TAKEN, S_MAX };
+
+  CBP_TRACE_READER *tracer = OpenTraceReader(inFileName, false);
+  CBP_TRACE_RECORD  rec;
+  FILE  *stream[S_MAX];
+  FILE  *out;
+  UINT32 lastPC = 0, lastTarget = 0;
+  int    i;
+
+  if ((out = fopen(outFileName, "wb")) == NULL) {
+    printf("Unable to create %s. Dying\n", outFileName);
+    exit(-1);
+  }
+
+  // each column is staged in its own temp file, then concatenated
+  for (i = 0; i < S_MAX; i++) {
+    if ((stream[i] = tmpfile()) == NULL) {
+      printf("Unable to create a temp file. Dying\n");
+      exit(-1);
+    }
+  }
+
+  while (tracer->GetNextRecord(&rec)) {
+    UINT8 op = rec.opType;
+    UINT8 tk = rec.branchTaken;
+
+    if (delta) {
+      unsigned char v[5];
+      fwrite(v, 1, CbpxPutVarint(v, CbpxZigZag(rec.PC - lastPC)), stream[S_PC]);
+      fwrite(v, 1, CbpxPutVarint(v, CbpxZigZag(rec.branchTarget - lastTarget)), stream[S_TARGET]);
+      lastPC = rec.PC;
+      lastTarget = rec.branchTarget;
+    } else {
+      fwrite(&rec.PC, 4, 1, stream[S_PC]);
+      fwrite(&rec.branchTarget, 4, 1, stream[S_TARGET]);
+    }
+    fwrite(&op, 1, 1, stream[S_OPTYPE]);
+    fwrite(&tk, 1, 1, stream[S_TAKEN]);
+
+    if (rec.opType == OPTYPE_BRANCH_COND) {
+      UINT64 index = tracer->GetNumInst() - 1;
+      fwrite(&index, 8, 1, stream[S_COND_INDEX]);
+      fwrite(&rec.PC, 4, 1, stream[S_COND_PC]);
+      fwrite(&rec.branchTarget, 4, 1, stream[S_COND_TARGET]);
+      fwrite(&tk, 1, 1, stream[S_COND_TAKEN]);
+    }
+  }
+
+  CBPX_HEADER hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, CBPX_MAGIC, CBPX_MAGIC_BYTES);
+  hdr.version       = CBPX_VERSION;
+  hdr.flags         = delta ? CBPX_FLAG_DELTA : 0;
+  hdr.numInst       = tracer->GetNumInst();
+  hdr.numCondBranch = tracer->GetNumCondBranch();
+
+  fwrite(&hdr, sizeof(hdr), 1, out);
+  hdr.pcOffset         = AppendStream(out, stream[S_PC]);
+  hdr.targetOffset     = AppendStream(out, stream[S_TARGET]);
+  hdr.opTypeOffset     = AppendStream(out, stream[S_OPTYPE]);
+  hdr.takenOffset      = AppendStream(out, stream[S_TAKEN]);
+  hdr.condIndexOffset  = AppendStream(out, stream[S_COND_INDEX]);
+  hdr.condPCOffset     = AppendStream(out, stream[S_COND_PC]);
+  hdr.condTargetOffset = AppendStream(out, stream[S_COND_TARGET]);
+  hdr.condTakenOffset  = AppendStream(out, stream[S_COND_TAKEN]);
+  hdr.fileBytes        = ftell(out);
+
+  rewind(out);
+  fwrite(&hdr, sizeof(hdr), 1, out);
+  fclose(out);
+
+  delete tracer;
+  return hdr.numInst;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
@@ -0,0 +1,135 @@
+#ifndef _CBPX_H_
+#define _CBPX_H_
+
+#include "utils.h"
+#include "tracer.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// .cbpx is a columnar rewrite of a CBP4 trace. After the header come
+// separate PC, target, opType and taken streams, followed by a branch
+// index holding every conditional branch (record number, PC, target,
+// direction) so conditional-only runs never touch the other records.
+//
+// With CBPX_FLAG_DELTA the PC and target streams hold zigzag varint
+// deltas against the previous record instead of raw 32-bit values.
+// All values are stored in host byte order, like the CBP4 records.
+
+#define CBPX_MAGIC         "CBPX\0\0\0\1"
+#define CBPX_MAGIC_BYTES   8
+#define CBPX_VERSION       1
+
+#define CBPX_FLAG_DELTA    0x1
+
+struct CBPX_HEADER{
+  char   magic[CBPX_MAGIC_BYTES];
+  UINT32 version;
+  UINT32 flags;
+
+  UINT64 numInst;
+  UINT64 numCondBranch;
+
+  // byte offsets from the start of the file, 8-byte aligned
+  UINT64 pcOffset;
+  UINT64 targetOffset;
+  UINT64 opTypeOffset;
+  UINT64 takenOffset;
+  UINT64 condIndexOffset;    // UINT64 record number per cond branch
+  UINT64 condPCOffset;       // UINT32 per cond branch
+  UINT64 condTargetOffset;   // UINT32 per cond branch
+  UINT64 condTakenOffset;    // UINT8 per cond branch
+  UINT64 fileBytes;
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+static inline UINT32 CbpxZigZag(UINT32 delta)
+{
+  return (delta << 1) ^ (UINT32)((INT32)delta >> 31);
+}
+
+static inline UINT32 CbpxUnZigZag(UINT32 z)
+{
+  return (z >> 1) ^ (0u - (z & 1));
+}
+
+// returns the number of bytes written to out (at most 5)
+static inline int CbpxPutVarint(unsigned char *out, UINT32 v)
+{
+  int n = 0;
+  while (v >= 0x80) {
+    out[n++] = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (unsigned char)v;
+  return n;
+}
+
+static inline UINT32 CbpxGetVarint(const unsigned char **in)
+{
+  const unsigned char *p = *in;
+  UINT32 v = 0;
+  int shift = 0;
+
+  while (*p & 0x80) {
+    v |= (UINT32)(*p++ & 0x7F) << shift;
+    shift += 7;
+  }
+  v |= (UINT32)(*p++) << shift;
+
+  *in = p;
+  return v;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Serves records straight out of a read-only mapping of a .cbpx file.
+// No decode buffer is involved; fields are read from the mapped columns.
+
+class CBPX_TRACER : public CBP_TRACE_READER{
+ private:
+  unsigned char *map;
+  UINT64 mapBytes;
+  bool   condOnly;
+
+  const CBPX_HEADER *hdr;
+  UINT64 cursor;             // next record (or cond branch with condOnly)
+
+  // plain streams
+  const UINT32 *pc;
+  const UINT32 *target;
+  const UINT8  *opType;
+  const UINT8  *taken;
+
+  // delta streams
+  const unsigned char *pcDelta;
+  const unsigned char *targetDelta;
+  UINT32 lastPC;
+  UINT32 lastTarget;
+
+  // branch index
+  const UINT64 *condIndex;
+  const UINT32 *condPC;
+  const UINT32 *condTarget;
+  const UINT8  *condTaken;
+
+ public:
+  CBPX_TRACER(char *traceFileName, bool condOnly=false);
+  ~CBPX_TRACER();
+
+  bool   GetNextRecord(CBP_TRACE_RECORD *record);
+  void   SkipTo(UINT64 inst);
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Rewrites any trace OpenTraceReader accepts into .cbpx.
+// Returns the number of records written.
+
+UINT64 ConvertToCbpx(char *inFileName, char *outFileName, bool delta);
+
+#endif // _CBPX_H_
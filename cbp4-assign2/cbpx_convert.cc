@@ -0,0 +1,27 @@
+#include <string.h>
+#include "utils.h"
+#include "tracer.h"
+#include "cbpx.h"
+
+
+// usage: cbpx_convert [-delta] <trace> <out.cbpx>
+
+int main(int argc, char* argv[]){
+  bool delta = false;
+  int  arg = 1;
+
+  if (argc > 1 && strcmp(argv[1], "-delta") == 0) {
+    delta = true;
+    arg++;
+  }
+
+  if (argc - arg != 2) {
+    printf("usage: %s [-delta] <trace> <out.cbpx>\n", argv[0]);
+    exit(-1);
+  }
+
+  UINT64 numInst = ConvertToCbpx(argv[arg], argv[arg + 1], delta);
+
+  printf("\nwrote %llu records to %s%s\n", numInst, argv[arg + 1],
+         delta ? " (delta-encoded)" : "");
+}
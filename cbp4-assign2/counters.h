@@ -0,0 +1,106 @@
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// word-parallel saturating counters
+/////////////////////////////////////////////////////////////
+
+// A UINT64 word holds 64/W counters of W bits each (32 2-bit counters,
+// 21 3-bit ones). The helpers below work on every lane of a word at
+// once. A lane is selected by setting its lowest bit in sel.
+
+// mask with the lowest bit of each of n W-bit lanes set
+constexpr UINT64 SwarLaneLsb(int W, int n) {
+    return n == 0 ? 0 : (SwarLaneLsb(W, n - 1) << W) | 1;
+}
+
+template <int W>
+struct SWAR_LANES {
+    static constexpr int    PER_WORD = 64 / W;
+    static constexpr UINT64 LSB      = SwarLaneLsb(W, PER_WORD);
+};
+
+// lowest bit of every lane whose W bits are all set
+template <int W>
+static inline UINT64 SwarAllOnes(UINT64 w) {
+    UINT64 t = w;
+    for (int b = 1; b < W; b++) {
+        t &= w >> b;
+    }
+    return t & SWAR_LANES<W>::LSB;
+}
+
+// lowest bit of every lane that is zero
+template <int W>
+static inline UINT64 SwarZero(UINT64 w) {
+    UINT64 t = w;
+    for (int b = 1; b < W; b++) {
+        t |= w >> b;
+    }
+    return ~t & SWAR_LANES<W>::LSB;
+}
+
+// increment the selected lanes, leaving saturated ones alone
+template <int W>
+static inline UINT64 SwarSatInc(UINT64 w, UINT64 sel) {
+    return w + (sel & ~SwarAllOnes<W>(w));
+}
+
+// decrement the selected lanes, leaving zero ones alone
+template <int W>
+static inline UINT64 SwarSatDec(UINT64 w, UINT64 sel) {
+    return w - (sel & ~SwarZero<W>(w));
+}
+
+// move the selected lanes toward taken (up) or not-taken (down)
+template <int W>
+static inline UINT64 SwarSatUpdate(UINT64 w, UINT64 sel, bool resolveDir) {
+    return resolveDir ? SwarSatInc<W>(w, sel) : SwarSatDec<W>(w, sel);
+}
+
+/////////////////////////////////////////////////////////////
+// packed counter table
+/////////////////////////////////////////////////////////////
+
+// 2^IDX_BITS saturating counters of CTR_BITS bits packed into UINT64
+// words, predicting taken in the upper half of their range. A 32K-entry
+// 2-bit table is 8KB.
+
+template <int IDX_BITS, int CTR_BITS>
+class SAT_COUNTER_TABLE {
+public:
+    static constexpr UINT32 ENTRIES  = 1u << IDX_BITS;
+    static constexpr UINT32 BITS     = CTR_BITS;
+    static constexpr UINT32 IDX_MASK = ENTRIES - 1;
+    static constexpr UINT32 CTR_MAX  = (1u << CTR_BITS) - 1;
+    static constexpr UINT32 CTR_INIT = CTR_MAX >> 1;   // weakly not-taken
+
+    static constexpr UINT32 PER_WORD = SWAR_LANES<CTR_BITS>::PER_WORD;
+    static constexpr UINT32 WORDS    = (ENTRIES + PER_WORD - 1) / PER_WORD;
+
+private:
+    UINT64 table[WORDS];
+
+    static UINT32 Word(UINT32 i)  { return (i & IDX_MASK) / PER_WORD; }
+    static UINT32 Shift(UINT32 i) { return ((i & IDX_MASK) % PER_WORD) * CTR_BITS; }
+
+public:
+    void Init() {
+        for (UINT32 i = 0; i < WORDS; i++) {
+            table[i] = SWAR_LANES<CTR_BITS>::LSB * CTR_INIT;
+        }
+    }
+
+    UINT32 Get(UINT32 i) const { return (table[Word(i)] >> Shift(i)) & CTR_MAX; }
+
+    bool Predict(UINT32 i) const { return Get(i) > CTR_INIT; }
+
+    void Update(UINT32 i, bool resolveDir) {
+        UINT64 *w = &table[Word(i)];
+        *w = SwarSatUpdate<CTR_BITS>(*w, 1ULL << Shift(i), resolveDir);
+    }
+};
+
+#endif // _COUNTERS_H_
@@ -0,0 +1,435 @@
+#include <string.h>
+#include "engine.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_ENGINE::CBP_ENGINE(){
+  profile = NULL;
+  series = NULL;
+  targets = NULL;
+  numSlices = 0;
+  sliceInst = 0;
+  warmInst = 0;
+  checkpointEvery = 0;
+  nextCheckpoint = 0;
+}
+
+CBP_ENGINE::~CBP_ENGINE(){
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].lane == 0) {
+      delete stats[i].predictor;
+    }
+  }
+  delete profile;
+  delete series;
+  delete targets;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+bool CBP_ENGINE::AddPredictor(const char *name){
+  CBP_PREDICTOR_STATS s;
+
+  if ((s.predictor = CreatePredictor(name)) == NULL) {
+    return false;
+  }
+  s.numLanes = s.predictor->NumLanes();
+  s.numMispred = 0;
+  s.weightedMPKI = 0;
+  s.predictor->Init();
+
+  if (s.numLanes > CBP_MAX_LANES) {
+    printf("%s has more than %d lanes. Dying\n", name, CBP_MAX_LANES);
+    exit(-1);
+  }
+
+  for (s.lane = 0; s.lane < s.numLanes; s.lane++) {
+    s.name = s.numLanes > 1 ? string(name) + "/" + s.predictor->GetLaneName(s.lane) : name;
+    stats.push_back(s);
+  }
+  return true;
+}
+
+void CBP_ENGINE::SetUpdateDelay(int branches){
+  for (size_t i = 0; i < stats.size(); i += stats[i].numLanes) {
+    if (!stats[i].predictor->SetUpdateDelay(branches)) {
+      printf("%s cannot delay its update by %d branches. Dying\n", stats[i].name.c_str(), branches);
+      exit(-1);
+    }
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::ProcessBatch(const CBP_TRACE_RECORD *rec, int count){
+  for (size_t i = 0; i < stats.size(); i += stats[i].numLanes) {
+    UINT64 wrong[CBP_MAX_LANES] = {0};
+
+    stats[i].predictor->RunBatch(rec, count, wrong);
+    for (int l = 0; l < stats[i].numLanes; l++) {
+      stats[i + l].numMispred += wrong[l];
+    }
+  }
+}
+
+void CBP_ENGINE::Run(CBP_TRACE_READER *tracer){
+  CBP_TRACE_RECORD rec;
+
+  if (!profile && !series && !targets && !checkpointEvery) {
+    vector<CBP_TRACE_RECORD> batch(CBP_ENGINE_BATCH);
+    int count = 0;
+
+    while (tracer->GetNextRecord(&batch[count])) {
+      if (batch[count].opType == OPTYPE_BRANCH_COND && ++count == CBP_ENGINE_BATCH) {
+        ProcessBatch(&batch[0], count);
+        count = 0;
+      }
+    }
+    ProcessBatch(&batch[0], count);
+    return;
+  }
+
+  while (tracer->GetNextRecord(&rec)) {
+    if(rec.opType == OPTYPE_BRANCH_COND){
+      ProcessBranch(&rec);
+    }
+    if (targets) {
+      targets->Process(&rec);
+    }
+    if (series && tracer->GetNumInst() >= series->NextEnd()) {
+      // only the trailing interval may end off its boundary
+      if (tracer->GetNumInst() != series->NextEnd()) {
+        printf("interval ended at instruction %llu instead of %llu. Dying\n",
+               tracer->GetNumInst(), series->NextEnd());
+        exit(-1);
+      }
+      SampleInterval(tracer);
+    }
+    if (checkpointEvery && tracer->GetNumInst() >= nextCheckpoint) {
+      SaveCheckpoint(checkpointFile.c_str(), tracer);
+      nextCheckpoint = tracer->GetNumInst() + checkpointEvery;
+    }
+  }
+
+  // the trailing partial interval
+  if (series) {
+    SampleInterval(tracer);
+  }
+}
+
+void CBP_ENGINE::SampleInterval(CBP_TRACE_READER *tracer){
+  vector<UINT64> mispred;
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    mispred.push_back(stats[i].numMispred);
+  }
+  series->Sample(tracer->GetNumInst(), tracer->GetNumCondBranch(), mispred);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::EnableProfile(){
+  delete profile;
+  profile = new CBP_BRANCH_PROFILE(stats.size());
+}
+
+void CBP_ENGINE::PrintProfile(UINT64 numInst, int topN){
+  vector<string> names;
+
+  if (profile == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < stats.size(); i++) {
+    names.push_back(stats[i].name);
+  }
+  profile->PrintReport(stdout, names, numInst, topN);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::RunSlices(CBP_TRACE_READER *tracer, const vector<CBP_SLICE> &slices,
+                           UINT64 length, UINT64 warmup){
+  CBP_TRACE_RECORD rec;
+  vector<UINT64>   base(stats.size(), 0);
+  double           totalWeight = 0;
+  bool             resumed = tracer->GetNumInst() > 0;
+  UINT64           prevEnd = tracer->GetNumInst();
+  UINT64           warmStart = 0, start = 0, end = 0;
+  bool             measuring = false;
+  size_t           k = 0;
+
+  // sets up slice k; returns false when there is none
+  auto begin = [&]() {
+    if (k == slices.size()) {
+      return false;
+    }
+    start = slices[k].start;
+    end = start + length;
+    warmStart = start > warmup ? start - warmup : 0;
+
+    if (warmStart > prevEnd || (k == 0 && !resumed)) {
+      // a restored checkpoint stands in for the prefix of the first slice
+      if (k > 0 || !resumed) {
+        for (size_t i = 0; i < stats.size(); i += stats[i].numLanes) {
+          stats[i].predictor->Init();
+        }
+      }
+      // nothing before the warm-up window is needed, skip it undecoded
+      tracer->SkipTo(warmStart);
+    } else {
+      warmStart = prevEnd;
+    }
+    measuring = false;
+    return true;
+  };
+
+  // charges slice k its mispredictions over the instructions it covered
+  auto finish = [&](UINT64 last) {
+    UINT64 inst = last - start;
+
+    if (inst > 0) {
+      for (size_t i = 0; i < stats.size(); i++) {
+        UINT64 m = measuring ? stats[i].numMispred - base[i] : 0;
+        stats[i].weightedMPKI += slices[k].weight * 1000.0 * m / inst;
+      }
+      totalWeight += slices[k].weight;
+      numSlices++;
+      sliceInst += inst;
+      warmInst += start - warmStart;
+    }
+    prevEnd = end;
+    k++;
+  };
+
+  if (resumed && slices[0].start < prevEnd) {
+    printf("the checkpoint lies past the first slice. Dying\n");
+    exit(-1);
+  }
+
+  begin();
+  while (tracer->GetNextRecord(&rec)) {
+    UINT64 pos = tracer->GetNumInst() - 1;
+
+    while (pos >= end) {
+      finish(end);
+      if (!begin()) {
+        break;
+      }
+    }
+    if (k == slices.size()) {
+      break;
+    }
+    if (pos < warmStart) {
+      continue;
+    }
+    if (!measuring && pos >= start) {
+      for (size_t i = 0; i < stats.size(); i++) {
+        base[i] = stats[i].numMispred;
+      }
+      measuring = true;
+    }
+    if(rec.opType == OPTYPE_BRANCH_COND){
+      ProcessBranch(&rec);
+    }
+  }
+
+  // the trace ended inside (or before) slice k
+  if (k < slices.size() && tracer->GetNumInst() > start) {
+    finish(tracer->GetNumInst());
+  }
+
+  for (size_t i = 0; i < stats.size() && totalWeight > 0; i++) {
+    stats[i].weightedMPKI /= totalWeight;
+  }
+}
+
+void CBP_ENGINE::PrintSliceStats(){
+  printf("\n");
+  printf("\nNUM_SLICES           \t : %10d",   numSlices);
+  printf("\nSLICE_INSTRUCTIONS   \t : %10llu", sliceInst);
+  printf("\nWARMUP_INSTRUCTIONS  \t : %10llu", warmInst);
+  printf("\n");
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    string label = stats[i].name + ":";
+
+    printf("\n%-8s WEIGHTED_MPKI        \t : %10.3f", label.c_str(), stats[i].weightedMPKI);
+    printf("\n%-8s STORAGE_BITS         \t : %10llu", label.c_str(), stats[i].predictor->GetLaneBudgetBits(stats[i].lane));
+  }
+  printf("\n\n");
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::EnableCheckpoints(const char *file, UINT64 every){
+  checkpointFile = file;
+  checkpointEvery = every;
+  nextCheckpoint = every;
+}
+
+UINT64 CBP_ENGINE::StateBytes(int i){
+  return stats[i].lane == 0 ? stats[i].predictor->GetStateBytes() : 0;
+}
+
+void CBP_ENGINE::SaveCheckpoint(const char *file, CBP_TRACE_READER *tracer){
+  string tmp = string(file) + ".tmp";
+  FILE  *out = fopen(tmp.c_str(), "wb");
+  UINT64 numInst = tracer->GetNumInst();
+  UINT64 numCondBranch = tracer->GetNumCondBranch();
+  UINT32 numPredictors = stats.size();
+  bool   ok;
+
+  if (out == NULL) {
+    printf("Unable to create %s. Dying\n", tmp.c_str());
+    exit(-1);
+  }
+
+  ok = fwrite(CBP_CHECKPOINT_MAGIC, 8, 1, out) == 1;
+  ok &= fwrite(&numInst, sizeof(numInst), 1, out) == 1;
+  ok &= fwrite(&numCondBranch, sizeof(numCondBranch), 1, out) == 1;
+  ok &= fwrite(&numPredictors, sizeof(numPredictors), 1, out) == 1;
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    UINT32 nameLen = stats[i].name.size();
+    UINT64 bytes = StateBytes(i);
+    vector<unsigned char> buf(bytes + 1);
+
+    // the state of a multi-lane predictor goes with its lane 0
+    if (bytes) {
+      stats[i].predictor->SaveState(&buf[0]);
+    }
+    ok &= fwrite(&nameLen, sizeof(nameLen), 1, out) == 1;
+    ok &= fwrite(stats[i].name.c_str(), nameLen, 1, out) == 1;
+    ok &= fwrite(&stats[i].numMispred, sizeof(UINT64), 1, out) == 1;
+    ok &= fwrite(&bytes, sizeof(bytes), 1, out) == 1;
+    if (bytes) {
+      ok &= fwrite(&buf[0], bytes, 1, out) == 1;
+    }
+  }
+  ok &= fclose(out) == 0;
+
+  // the old checkpoint survives a crash or full disk mid-write
+  if (!ok || rename(tmp.c_str(), file) != 0) {
+    printf("Unable to write the checkpoint %s. Dying\n", file);
+    exit(-1);
+  }
+}
+
+void CBP_ENGINE::RestoreCheckpoint(const char *file, CBP_TRACE_READER *tracer){
+  FILE  *in = fopen(file, "rb");
+  char   magic[8];
+  UINT64 numInst, numCondBranch;
+  UINT32 numPredictors;
+
+  if (in == NULL) {
+    printf("Unable to open the checkpoint %s. Dying\n", file);
+    exit(-1);
+  }
+  if (fread(magic, 8, 1, in) != 1 || memcmp(magic, CBP_CHECKPOINT_MAGIC, 8) != 0 ||
+      fread(&numInst, sizeof(numInst), 1, in) != 1 ||
+      fread(&numCondBranch, sizeof(numCondBranch), 1, in) != 1 ||
+      fread(&numPredictors, sizeof(numPredictors), 1, in) != 1 ||
+      numPredictors != stats.size()) {
+    printf("%s is not a checkpoint of these predictors. Dying\n", file);
+    exit(-1);
+  }
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    UINT32 nameLen;
+    UINT64 bytes;
+    string name;
+
+    if (fread(&nameLen, sizeof(nameLen), 1, in) != 1 || nameLen > 256) {
+      printf("Truncated checkpoint %s. Dying\n", file);
+      exit(-1);
+    }
+    name.resize(nameLen);
+    if (fread(&name[0], nameLen, 1, in) != 1 || name != stats[i].name ||
+        fread(&stats[i].numMispred, sizeof(UINT64), 1, in) != 1 ||
+        fread(&bytes, sizeof(bytes), 1, in) != 1 ||
+        bytes != StateBytes(i)) {
+      printf("%s does not match predictor %s. Dying\n", file, stats[i].name.c_str());
+      exit(-1);
+    }
+
+    vector<unsigned char> buf(bytes + 1);
+    if (bytes && fread(&buf[0], bytes, 1, in) != 1) {
+      printf("Truncated checkpoint %s. Dying\n", file);
+      exit(-1);
+    }
+    if (bytes) {
+      stats[i].predictor->RestoreState(&buf[0]);
+    }
+  }
+  fclose(in);
+
+  tracer->SkipTo(numInst);
+  if (tracer->GetNumInst() != numInst || tracer->GetNumCondBranch() != numCondBranch) {
+    printf("%s was taken on a different trace. Dying\n", file);
+    exit(-1);
+  }
+  if (checkpointEvery) {
+    nextCheckpoint = numInst + checkpointEvery;
+  }
+  if (series) {
+    vector<UINT64> mispred;
+
+    for (size_t i = 0; i < stats.size(); i++) {
+      mispred.push_back(stats[i].numMispred);
+    }
+    series->Rebase(numInst, numCondBranch, mispred);
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::EnableTargets(){
+  delete targets;
+  targets = new CBP_TARGET_MODEL();
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::EnableTimeSeries(UINT64 length){
+  delete series;
+  series = new CBP_TIME_SERIES(length, stats.size());
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_ENGINE::PrintStats(UINT64 numInst, UINT64 numCondBranch){
+  printf("\n");
+  printf("\nNUM_INSTRUCTIONS     \t : %10llu",   numInst);
+  printf("\nNUM_CONDITIONAL_BR   \t : %10llu",   numCondBranch);
+  printf("\n");
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    string label = stats[i].name + ":";
+
+    printf("\n%-8s NUM_MISPREDICTIONS   \t : %10llu", label.c_str(), stats[i].numMispred);
+    printf("\n%-8s MISPRED_PER_1K_INST  \t : %10.3f", label.c_str(), 1000.0*(double)(stats[i].numMispred)/(double)(numInst));
+    printf("\n%-8s STORAGE_BITS         \t : %10llu", label.c_str(), stats[i].predictor->GetLaneBudgetBits(stats[i].lane));
+  }
+  if (series) {
+    printf("\n");
+    printf("\nNUM_INTERVALS        \t : %10d",   series->NumIntervals());
+    printf("\nNUM_PHASE_CHANGES    \t : %10d",   series->NumPhaseChanges());
+  }
+  printf("\n\n");
+
+  if (targets) {
+    targets->PrintStats(numInst);
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
@@ -0,0 +1,164 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+#include "predictor.h"
+#include "profile.h"
+#include "interval.h"
+#include "slices.h"
+#include "target.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// One row of the stats table: a predictor instance (or one lane of a
+// multi-lane predictor) and its counters.
+
+struct CBP_PREDICTOR_STATS{
+  string         name;             // predictor, or predictor/lane
+  CBP_PREDICTOR *predictor;        // shared by all lanes of one predictor
+  int            lane;
+  int            numLanes;
+  UINT64         numMispred;
+  double         weightedMPKI;     // RunSlices only
+};
+
+#define CBP_ENGINE_BATCH   1024    // conditional branches per RunBatch call
+#define CBP_MAX_LANES      64
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// A checkpoint holds the trace position and, per predictor, its name,
+// misprediction count and raw state, all in host byte order:
+//
+//   magic[8] numInst:u64 numCondBranch:u64 numPredictors:u32
+//   { nameLen:u32 name numMispred:u64 stateBytes:u64 state }*
+
+#define CBP_CHECKPOINT_MAGIC "CBPCK\0\0\1"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Feeds every conditional branch of a single trace pass to all the
+// predictors it holds, so N designs cost one decode instead of N.
+
+class CBP_ENGINE{
+ private:
+  vector<CBP_PREDICTOR_STATS> stats;
+  CBP_BRANCH_PROFILE         *profile;     // NULL unless EnableProfile
+  CBP_TIME_SERIES            *series;      // NULL unless EnableTimeSeries
+  CBP_TARGET_MODEL           *targets;     // NULL unless EnableTargets
+
+  void   SampleInterval(CBP_TRACE_READER *tracer);
+  UINT64 StateBytes(int i);               // checkpointed bytes of row i
+
+  int    numSlices;                        // slices actually run
+  UINT64 sliceInst;                        // instructions measured in them
+  UINT64 warmInst;                         // instructions run to warm up
+
+  string checkpointFile;
+  UINT64 checkpointEvery;                  // 0: no periodic checkpoints
+  UINT64 nextCheckpoint;
+
+ public:
+  CBP_ENGINE();
+  ~CBP_ENGINE();
+
+  // returns false if no predictor is registered under name
+  bool   AddPredictor(const char *name);
+
+  // delayed update for every predictor added so far (see
+  // CBP_PREDICTOR::SetUpdateDelay); dies if one cannot model it
+  void   SetUpdateDelay(int branches);
+
+  int    NumPredictors(){ return stats.size(); }
+  const  CBP_PREDICTOR_STATS *GetStats(int i){ return &stats[i]; }
+
+  // per-PC counters for every branch; call after the last AddPredictor
+  void   EnableProfile();
+  void   PrintProfile(UINT64 numInst, int topN);
+
+  // BTB, RAS and indirect target prediction for every control transfer;
+  // Run must then be given a reader that returns all records
+  void   EnableTargets();
+
+  // MPKI per predictor every `length` instructions; call after the last AddPredictor
+  void   EnableTimeSeries(UINT64 length);
+  CBP_TIME_SERIES *GetTimeSeries(){ return series; }
+
+  void   ProcessBranch(const CBP_TRACE_RECORD *rec);
+
+  // count conditional branches, predictor by predictor
+  void   ProcessBatch(const CBP_TRACE_RECORD *rec, int count);
+
+  // batched unless a per-record feature (profile, time series, targets,
+  // checkpoints) is enabled
+  void   Run(CBP_TRACE_READER *tracer);
+  void   PrintStats(UINT64 numInst, UINT64 numCondBranch);
+
+  // Runs only the given slices. Before each slice the predictors are
+  // re-initialised and trained on up to `warmup` preceding instructions,
+  // unless the previous slice ends inside that window, in which case
+  // they carry on from it. If a checkpoint has been restored, the first
+  // slice starts from its state instead. MPKI is weighted by the slice
+  // weights.
+  void   RunSlices(CBP_TRACE_READER *tracer, const vector<CBP_SLICE> &slices,
+                   UINT64 length, UINT64 warmup);
+  void   PrintSliceStats();
+
+  // Run saves a checkpoint to file every `every` instructions, replacing
+  // the previous one only once the new one is complete
+  void   EnableCheckpoints(const char *file, UINT64 every);
+  void   SaveCheckpoint(const char *file, CBP_TRACE_READER *tracer);
+
+  // restores every predictor and its count and moves the tracer to the
+  // saved position; dies if the checkpoint does not match this run
+  void   RestoreCheckpoint(const char *file, CBP_TRACE_READER *tracer);
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+inline void CBP_ENGINE::ProcessBranch(const CBP_TRACE_RECORD *rec){
+  UINT32 slot = 0;
+
+  if (profile) {
+    slot = profile->Lookup(rec->PC);
+    profile->Record(slot, rec->branchTaken);
+  }
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    CBP_PREDICTOR_STATS *s = &stats[i];
+
+    if (s->numLanes > 1) {
+      UINT64 wrong[CBP_MAX_LANES] = {0};
+
+      s->predictor->RunBatch(rec, 1, wrong);
+      for (int l = 0; l < s->numLanes; l++) {
+        stats[i + l].numMispred += wrong[l];
+        if (profile && wrong[l]) {
+          profile->RecordMispred(slot, i + l);
+        }
+      }
+      i += s->numLanes - 1;
+      continue;
+    }
+
+    bool predDir = s->predictor->GetPrediction(rec->PC);
+
+    s->predictor->UpdatePredictor(rec->PC, rec->branchTaken,
+                                  predDir, rec->branchTarget);
+
+    if(predDir != rec->branchTaken){
+      s->numMispred++; // update mispred stats
+      if (profile) {
+        profile->RecordMispred(slot, i);
+      }
+    }
+  }
+}
+
+#endif // _ENGINE_H_
@@ -0,0 +1,75 @@
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <string.h>
+#include "utils.h"
+
+/////////////////////////////////////////////////////////////
+// global history
+/////////////////////////////////////////////////////////////
+
+// Branch outcomes in a circular buffer of 2^LOG_BUF bits, one per byte,
+// newest at age 0. The buffer must be longer than the longest history
+// read from it.
+
+template <int LOG_BUF>
+class GLOBAL_HISTORY {
+public:
+    static constexpr UINT32 SIZE = 1u << LOG_BUF;
+    static constexpr UINT32 MASK = SIZE - 1;
+
+private:
+    UINT8  bits[SIZE];
+    UINT32 ptr;
+
+public:
+    void Init() {
+        memset(bits, 0, sizeof(bits));
+        ptr = 0;
+    }
+
+    UINT32 operator[](UINT32 age) const { return bits[(ptr + age) & MASK]; }
+
+    void Push(bool resolveDir) {
+        ptr = (ptr - 1) & MASK;
+        bits[ptr] = resolveDir;
+    }
+
+    // Pushes never touch bits older than the newest one, so a position
+    // saved here can be rewound to until the buffer wraps onto the
+    // longest history still being read.
+    UINT32 Checkpoint() const { return ptr; }
+    void   Rewind(UINT32 pos) { ptr = pos; }
+};
+
+/////////////////////////////////////////////////////////////
+// folded history
+/////////////////////////////////////////////////////////////
+
+// The newest origLen bits of global history XOR-folded down to compLen
+// bits, kept up to date in O(1) per branch (Seznec's circular shift
+// register). Update must be called right after every GLOBAL_HISTORY::Push.
+
+struct FOLDED_HISTORY {
+    UINT32 comp;
+    int    compLen;
+    int    origLen;
+    int    outPoint;
+
+    void Init(int origLen, int compLen) {
+        this->comp     = 0;
+        this->origLen  = origLen;
+        this->compLen  = compLen;
+        this->outPoint = origLen % compLen;
+    }
+
+    template <class H>
+    void Update(const H &h) {
+        comp = (comp << 1) ^ h[0];
+        comp ^= h[origLen] << outPoint;
+        comp ^= comp >> compLen;
+        comp &= (1u << compLen) - 1;
+    }
+};
+
+#endif // _HISTORY_H_
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <math.h>
+#include "interval.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_TIME_SERIES::CBP_TIME_SERIES(UINT64 length, int numPredictors)
+  : lastMispred(numPredictors, 0), phaseSum(numPredictors, 0.0){
+
+  this->length = length;
+  nextEnd = length;
+  lastInst = 0;
+  lastCondBranch = 0;
+  phaseLen = 0;
+  numPhaseChanges = 0;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_TIME_SERIES::Rebase(UINT64 numInst, UINT64 numCondBranch, const vector<UINT64> &mispred){
+  nextEnd = (numInst / length + 1) * length;
+  lastInst = numInst;
+  lastCondBranch = numCondBranch;
+  lastMispred = mispred;
+}
+
+void CBP_TIME_SERIES::Sample(UINT64 numInst, UINT64 numCondBranch, const vector<UINT64> &mispred){
+  CBP_INTERVAL iv;
+  bool         change = false;
+
+  if (numInst == lastInst) {
+    return;
+  }
+
+  iv.endInst = numInst;
+  iv.numInst = numInst - lastInst;
+  iv.numCondBranch = numCondBranch - lastCondBranch;
+
+  for (size_t p = 0; p < mispred.size(); p++) {
+    UINT32 m = mispred[p] - lastMispred[p];
+    double mpki = 1000.0 * m / iv.numInst;
+
+    iv.numMispred.push_back(m);
+    if (phaseLen > 0) {
+      double mean = phaseSum[p] / phaseLen;
+      if (fabs(mpki - mean) > max(CBP_PHASE_REL * mean, CBP_PHASE_ABS)) {
+        change = true;
+      }
+    }
+  }
+
+  // a new phase starts its mean from this interval
+  if (change) {
+    numPhaseChanges++;
+    phaseLen = 0;
+    phaseSum.assign(phaseSum.size(), 0.0);
+  }
+  for (size_t p = 0; p < mispred.size(); p++) {
+    phaseSum[p] += 1000.0 * iv.numMispred[p] / iv.numInst;
+  }
+  phaseLen++;
+
+  iv.phaseChange = change;
+  intervals.push_back(iv);
+
+  lastInst = numInst;
+  lastCondBranch = numCondBranch;
+  lastMispred = mispred;
+  nextEnd += length;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_TIME_SERIES::WriteCSV(FILE *out, const vector<string> &names){
+  fprintf(out, "END_INST,NUM_INST,NUM_CONDITIONAL_BR,PHASE_CHANGE");
+  for (size_t p = 0; p < names.size(); p++) {
+    fprintf(out, ",%s", names[p].c_str());
+  }
+  fprintf(out, "\n");
+
+  for (size_t i = 0; i < intervals.size(); i++) {
+    const CBP_INTERVAL *iv = &intervals[i];
+
+    fprintf(out, "%llu,%llu,%u,%d", iv->endInst, iv->numInst, iv->numCondBranch, iv->phaseChange);
+    for (size_t p = 0; p < names.size(); p++) {
+      fprintf(out, ",%.3f", 1000.0 * iv->numMispred[p] / iv->numInst);
+    }
+    fprintf(out, "\n");
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+static void PutLE(FILE *out, UINT64 v, int bytes){
+  for (int i = 0; i < bytes; i++) {
+    fputc((v >> (8 * i)) & 0xff, out);
+  }
+}
+
+void CBP_TIME_SERIES::WriteBinary(FILE *out, const vector<string> &names){
+  fwrite(CBP_SERIES_MAGIC, 1, 8, out);
+  PutLE(out, names.size(), 4);
+  PutLE(out, length, 8);
+  for (size_t p = 0; p < names.size(); p++) {
+    fwrite(names[p].c_str(), 1, names[p].size() + 1, out);
+  }
+
+  for (size_t i = 0; i < intervals.size(); i++) {
+    const CBP_INTERVAL *iv = &intervals[i];
+
+    PutLE(out, iv->endInst, 8);
+    PutLE(out, iv->numCondBranch, 4);
+    PutLE(out, iv->phaseChange, 1);
+    for (size_t p = 0; p < names.size(); p++) {
+      PutLE(out, iv->numMispred[p], 4);
+    }
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
@@ -0,0 +1,76 @@
+#ifndef _INTERVAL_H_
+#define _INTERVAL_H_
+
+#include <stdio.h>
+#include <vector>
+#include "utils.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// A phase change is flagged when some predictor's interval MPKI moves
+// away from the mean of the current phase by more than
+// max(REL * mean, ABS).
+
+#define CBP_PHASE_REL   0.5
+#define CBP_PHASE_ABS   1.0    // MPKI
+
+#define CBP_SERIES_MAGIC "CBPTS\0\0\1"
+
+// One fixed instruction interval. Counts are for the interval alone.
+
+struct CBP_INTERVAL{
+  UINT64         endInst;          // trace position at the end of the interval
+  UINT64         numInst;
+  UINT32         numCondBranch;
+  vector<UINT32> numMispred;       // per predictor
+  bool           phaseChange;      // first interval of a new phase
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Samples cumulative misprediction counts every `length` instructions
+// and keeps the per-interval deltas, flagging phase changes as it goes.
+// The series is written as CSV or as a compact binary file:
+//
+//   magic[8] numPredictors:u32 length:u64 name\0 ... (per predictor)
+//   { endInst:u64 numCondBranch:u32 phaseChange:u8 numMispred:u32 ... }*
+//
+// with every integer little-endian.
+
+class CBP_TIME_SERIES{
+ private:
+  UINT64               length;
+  UINT64               nextEnd;
+  UINT64               lastInst;
+  UINT64               lastCondBranch;
+  vector<UINT64>       lastMispred;
+
+  vector<double>       phaseSum;   // MPKI summed over the current phase
+  int                  phaseLen;   // intervals in the current phase
+  int                  numPhaseChanges;
+
+  vector<CBP_INTERVAL> intervals;
+
+ public:
+  CBP_TIME_SERIES(UINT64 length, int numPredictors);
+
+  UINT64 NextEnd(){ return nextEnd; }
+
+  // starts the series over from a restored position (a checkpoint), the
+  // first interval then ends on the next boundary past numInst
+  void   Rebase(UINT64 numInst, UINT64 numCondBranch, const vector<UINT64> &mispred);
+
+  // closes the interval ending at numInst; mispred is cumulative
+  void   Sample(UINT64 numInst, UINT64 numCondBranch, const vector<UINT64> &mispred);
+
+  int    NumIntervals(){ return intervals.size(); }
+  int    NumPhaseChanges(){ return numPhaseChanges; }
+  const  CBP_INTERVAL *GetInterval(int i){ return &intervals[i]; }
+
+  void   WriteCSV(FILE *out, const vector<string> &names);
+  void   WriteBinary(FILE *out, const vector<string> &names);
+};
+
+#endif // _INTERVAL_H_
@@ -14,99 +14,286 @@
 
 
 
+#include <string.h>
+#include <thread>
 #include "utils.h"
 #include "tracer.h"
 #include "predictor.h"
+#include "engine.h"
+#include "sweep.h"
+#include "slices.h"
 
 
-// usage: predictor <trace>
+// predictors run when -p is not given
+static const char *defaultPredictors = "2bitsat,2level,openend";
+
+static void usage(char *prog){
+  printf("usage: %s [-p <name>[,<name>...]] [-budget <KB>] [-delay <n>] [-profile <N>] [-targets] [-list] [-state <name>]\n"
+         "                 [-interval <inst> [-timeseries <file> [-binary]]]\n"
+         "                 [-slices <file> [-warmup <inst>]]\n"
+         "                 [-checkpoint <file> [-every <inst>]] [-resume <file>] <trace>\n", prog);
+  printf("       %s -sweep [-p <name>[,<name>...]] [-budget <KB>] [-delay <n>] [-threads <n>] [-no-shared-decode]\n"
+         "                 [-json] [-o <file>] <trace> [<trace>...]\n", prog);
+  exit(-1);
+}
+
+static void listPredictors(){
+  for (int i = 0; i < NumRegisteredPredictors(); i++) {
+    const CBP_PREDICTOR_ENTRY *e = GetRegisteredPredictor(i);
+    CBP_PREDICTOR *p = e->create();
+
+    printf("%-14s %8.2f KB  %s\n", e->name, p->GetBudgetBits() / 8192.0, e->desc);
+    delete p;
+  }
+}
+
+// per-table storage breakdown of one predictor
+static void printState(const char *name){
+  CBP_PREDICTOR *p = CreatePredictor(name);
+  CBP_STATE      state;
+
+  if (p == NULL) {
+    printf("unknown predictor '%s', use -list to see the registered ones\n", name);
+    exit(-1);
+  }
+  p->DescribeState(&state);
+
+  for (int i = 0; i < state.NumEntries(); i++) {
+    const CBP_STATE_ENTRY *e = state.GetEntry(i);
+    printf("%-20s %8llu x %3u bits = %10llu bits\n", e->name.c_str(), e->entries, e->bits, e->entries * e->bits);
+  }
+  printf("%-20s %37llu bits (%.2f KB)\n", "total", state.GetTotalBits(), state.GetTotalBits() / 8192.0);
+  delete p;
+}
+
+// splits a comma-separated predictor list, dying on unknown names and
+// dropping any predictor whose storage exceeds budgetBits (0: no limit)
+static vector<string> parsePredictors(const char *list, UINT64 budgetBits){
+  vector<string> names;
+  string         all = list;
+  size_t         pos = 0;
+
+  while (true) {
+    size_t comma = all.find(',', pos);
+    string name = all.substr(pos, comma == string::npos ? string::npos : comma - pos);
+    CBP_PREDICTOR *p = CreatePredictor(name.c_str());
+
+    if (p == NULL) {
+      printf("unknown predictor '%s', use -list to see the registered ones\n", name.c_str());
+      exit(-1);
+    }
+    if (budgetBits && p->GetBudgetBits() > budgetBits) {
+      printf("rejecting %s: %llu bits exceeds the %llu-bit budget\n", name.c_str(), p->GetBudgetBits(), budgetBits);
+    } else {
+      names.push_back(name);
+    }
+    delete p;
+
+    if (comma == string::npos) {
+      if (names.empty()) {
+        printf("no predictor fits the budget. Dying\n");
+        exit(-1);
+      }
+      return names;
+    }
+    pos = comma + 1;
+  }
+}
+
+// usage: predictor [-p <name>[,<name>...]] [-budget <KB>] [-delay <n>] [-profile <N>] [-targets] [-list] [-state <name>]
+//                  [-interval <inst> [-timeseries <file> [-binary]]]
+//                  [-slices <file> [-warmup <inst>]]
+//                  [-checkpoint <file> [-every <inst>]] [-resume <file>] <trace>
+//        predictor -sweep [-p ...] [-budget <KB>] [-delay <n>] [-threads <n>] [-no-shared-decode] [-json] [-o <file>] <trace>...
 
 int main(int argc, char* argv[]){
   
-  if (argc != 2) {
-    printf("usage: %s <trace>\n", argv[0]);
-    exit(-1);
+  const char    *predictorList = defaultPredictors;
+  vector<string> traceFiles;
+  bool           sweep = false;
+  bool           json = false;
+  bool           sharedDecode = true;
+  int            numThreads = thread::hardware_concurrency();
+  const char    *outFile = NULL;
+  UINT64         budgetBits = 0;
+  int            profileTop = 0;
+  bool           targets = false;
+  UINT64         interval = 0;
+  const char    *seriesFile = NULL;
+  bool           seriesBinary = false;
+  const char    *sliceFile = NULL;
+  UINT64         warmup = 1000000;
+  const char    *checkpointFile = NULL;
+  UINT64         checkpointEvery = 100000000;
+  const char    *resumeFile = NULL;
+  int            updateDelay = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      predictorList = argv[++i];
+    } else if (strcmp(argv[i], "-list") == 0) {
+      listPredictors();
+      exit(0);
+    } else if (strcmp(argv[i], "-state") == 0 && i + 1 < argc) {
+      printState(argv[++i]);
+      exit(0);
+    } else if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc) {
+      budgetBits = (UINT64) (atof(argv[++i]) * 8192);
+    } else if (strcmp(argv[i], "-profile") == 0 && i + 1 < argc) {
+      profileTop = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-targets") == 0) {
+      targets = true;
+    } else if (strcmp(argv[i], "-interval") == 0 && i + 1 < argc) {
+      interval = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-timeseries") == 0 && i + 1 < argc) {
+      seriesFile = argv[++i];
+    } else if (strcmp(argv[i], "-binary") == 0) {
+      seriesBinary = true;
+    } else if (strcmp(argv[i], "-slices") == 0 && i + 1 < argc) {
+      sliceFile = argv[++i];
+    } else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc) {
+      warmup = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc) {
+      checkpointFile = argv[++i];
+    } else if (strcmp(argv[i], "-every") == 0 && i + 1 < argc) {
+      checkpointEvery = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "-resume") == 0 && i + 1 < argc) {
+      resumeFile = argv[++i];
+    } else if (strcmp(argv[i], "-delay") == 0 && i + 1 < argc) {
+      updateDelay = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-sweep") == 0) {
+      sweep = true;
+    } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+      numThreads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-no-shared-decode") == 0) {
+      sharedDecode = false;
+    } else if (strcmp(argv[i], "-json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      outFile = argv[++i];
+    } else if (argv[i][0] != '-') {
+      traceFiles.push_back(argv[i]);
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  if (traceFiles.empty() || (!sweep && traceFiles.size() != 1)) {
+    usage(argv[0]);
+  }
+  // interval counts are stored in 32 bits
+  if (interval > 0xffffffffull || (seriesFile != NULL && interval == 0)) {
+    usage(argv[0]);
+  }
+
+  vector<string> predictors = parsePredictors(predictorList, budgetBits);
+
+  ///////////////////////////////////////////////
+  // sweep: every trace x every predictor, one aggregated table
+  ///////////////////////////////////////////////
+
+  if (sweep) {
+    CBP_SWEEP runner(traceFiles, predictors, numThreads, sharedDecode, updateDelay);
+    FILE     *out = stdout;
+
+    runner.Run();
+
+    if (outFile != NULL && (out = fopen(outFile, "w")) == NULL) {
+      printf("Unable to create %s. Dying\n", outFile);
+      exit(-1);
+    }
+    if (json) {
+      runner.WriteJSON(out);
+    } else {
+      runner.WriteCSV(out);
+    }
+    if (out != stdout) {
+      fclose(out);
+    }
+    return 0;
   }
   
   ///////////////////////////////////////////////
   // Init variables
   ///////////////////////////////////////////////
-    
-    CBP_TRACER *tracer = new CBP_TRACER(argv[1]);
-    CBP_TRACE_RECORD *trace = new CBP_TRACE_RECORD();
 
-    UINT64     numMispred_2bitsat =0;  
-    UINT64     numMispred_2level =0;  
-    UINT64     numMispred_openend =0;  
+    CBP_ENGINE engine;
 
-    InitPredictor_2bitsat();
-    InitPredictor_2level();
-    InitPredictor_openend();
+    for (size_t i = 0; i < predictors.size(); i++) {
+      engine.AddPredictor(predictors[i].c_str());
+    }
+    engine.SetUpdateDelay(updateDelay);
+    if (profileTop > 0) {
+      engine.EnableProfile();
+    }
+    if (targets) {
+      engine.EnableTargets();
+    }
+    if (interval > 0) {
+      engine.EnableTimeSeries(interval);
+    }
+    if (checkpointFile != NULL && checkpointEvery > 0) {
+      engine.EnableCheckpoints(checkpointFile, checkpointEvery);
+    }
     
+    // unless targets are modelled only conditional branches are simulated,
+    // so let the reader skip the rest; intervals need every instruction to
+    // end exactly on their boundaries
+    CBP_TRACE_READER *tracer = OpenTraceReader((char *) traceFiles[0].c_str(), !targets && interval == 0);
+
+    // continue a run from where its checkpoint left off
+    if (resumeFile != NULL) {
+      engine.RestoreCheckpoint(resumeFile, tracer);
+    }
+
+  ///////////////////////////////////////////////
+  // sliced run: representative slices only, weighted MPKI
+  ///////////////////////////////////////////////
+
+    if (sliceFile != NULL) {
+      vector<CBP_SLICE> slices;
+      UINT64            length;
+
+      ReadSlices(sliceFile, &length, &slices);
+      engine.RunSlices(tracer, slices, length, warmup);
+      engine.PrintSliceStats();
+
+      delete tracer;
+      return 0;
+    }
+
   ///////////////////////////////////////////////
   // read each trace recod, simulate until done
   ///////////////////////////////////////////////
 
-      while (tracer->GetNextRecord(trace)) {
-
-	if(trace->opType == OPTYPE_BRANCH_COND){
-      bool predDir_2bitsat;
-      bool predDir_2level;
-      bool predDir_openend;
-
-      // 2bitsat
-	  predDir_2bitsat = GetPrediction_2bitsat(trace->PC);
-
-      // 2level
-	  predDir_2level = GetPrediction_2level(trace->PC);
-
-      // openend
-	  predDir_openend = GetPrediction_openend(trace->PC);
-
-      // 2bitsat
-	  UpdatePredictor_2bitsat(trace->PC, trace->branchTaken, 
-				  predDir_2bitsat, trace->branchTarget);
-	  
-	  if(predDir_2bitsat != trace->branchTaken){
-	    numMispred_2bitsat++; // update mispred stats
-	  }
-	  
-      // 2level
-	  UpdatePredictor_2level(trace->PC, trace->branchTaken, 
-				  predDir_2level, trace->branchTarget);
-	  
-	  if(predDir_2level != trace->branchTaken){
-	    numMispred_2level++; // update mispred stats
-	  }
-	  
-      // openend
-	  UpdatePredictor_openend(trace->PC, trace->branchTaken, 
-				  predDir_openend, trace->branchTarget);
-	  
-	  if(predDir_openend != trace->branchTaken){
-	    numMispred_openend++; // update mispred stats
-	  }
-	  
-	}
-      
-      }
+    engine.Run(tracer);
 
     ///////////////////////////////////////////
     //print_stats
     ///////////////////////////////////////////
 
-      printf("\n");
-      printf("\nNUM_INSTRUCTIONS     \t : %10llu",   tracer->GetNumInst());
-      printf("\nNUM_CONDITIONAL_BR   \t : %10llu",   tracer->GetNumCondBranch());
-      printf("\n");
-      printf("\n2bitsat: NUM_MISPREDICTIONS   \t : %10llu",   numMispred_2bitsat);
-      printf("\n2bitsat: MISPRED_PER_1K_INST  \t : %10.3f",   1000.0*(double)(numMispred_2bitsat)/(double)(tracer->GetNumInst()));
-      printf("\n2level:  NUM_MISPREDICTIONS   \t : %10llu",   numMispred_2level);
-      printf("\n2level:  MISPRED_PER_1K_INST  \t : %10.3f",   1000.0*(double)(numMispred_2level)/(double)(tracer->GetNumInst()));
-      printf("\nopenend: NUM_MISPREDICTIONS   \t : %10llu",   numMispred_openend);
-      printf("\nopenend: MISPRED_PER_1K_INST  \t : %10.3f",   1000.0*(double)(numMispred_openend)/(double)(tracer->GetNumInst()));
-      printf("\n\n");
-}
+    engine.PrintStats(tracer->GetNumInst(), tracer->GetNumCondBranch());
+    engine.PrintProfile(tracer->GetNumInst(), profileTop);
+
+    if (seriesFile != NULL) {
+      FILE          *out = fopen(seriesFile, seriesBinary ? "wb" : "w");
+      vector<string> names;
 
+      if (out == NULL) {
+        printf("Unable to create %s. Dying\n", seriesFile);
+        exit(-1);
+      }
+      for (int i = 0; i < engine.NumPredictors(); i++) {
+        names.push_back(engine.GetStats(i)->name);
+      }
+      if (seriesBinary) {
+        engine.GetTimeSeries()->WriteBinary(out, names);
+      } else {
+        engine.GetTimeSeries()->WriteCSV(out, names);
+      }
+      fclose(out);
+    }
 
+    delete tracer;
+}
 
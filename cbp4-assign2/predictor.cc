@@ -1,204 +1,1018 @@
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <type_traits>
 #include "predictor.h"
+#include "counters.h"
+#include "history.h"
 
 using namespace std;
 
+// Every predictor below is a template on its table geometry, so the masks
+// are compile-time constants and each configuration in the registry is a
+// separate instantiation with no runtime branching on sizes.
+//
+// Besides Predict/Update (train and shift history at once) each one
+// exposes the split used for delayed update: PredictSpec records in a
+// SPEC what the prediction was made from (indices and the history it
+// saw), PushHistory shifts a (possibly speculative) outcome into the
+// histories, RestoreHistory rewinds them to a SPEC, and Train updates
+// the tables from a SPEC once the branch resolves.
+
 /////////////////////////////////////////////////////////////
-// 2bitsat
+// building blocks
 /////////////////////////////////////////////////////////////
-int prediction_table[4096];
 
-void InitPredictor_2bitsat() {
-    for (int i = 0; i < 4096; i++) {
-        prediction_table[i] = 1;
-    }
+// smallest unsigned type holding BITS bits
+template <int BITS>
+struct UINT_FOR {
+    typedef typename conditional<(BITS <= 8), UINT8,
+            typename conditional<(BITS <= 16), unsigned short, UINT32>::type>::type type;
+};
+
+// declares a counter table as state
+template <class T>
+static void DescribeCounters(CBP_STATE *s, const string &name) {
+    s->Add(name, T::ENTRIES, T::BITS);
 }
 
-bool GetPrediction_2bitsat(UINT32 PC) {
-    if (prediction_table[PC & 0xFFF] <= 1) {
-        return NOT_TAKEN;
-    } else {
-        return TAKEN;
+/////////////////////////////////////////////////////////////
+// bimodal: 2^IDX_BITS counters indexed by the low PC bits
+/////////////////////////////////////////////////////////////
+template <int IDX_BITS, int CTR_BITS>
+class BIMODAL {
+    SAT_COUNTER_TABLE<IDX_BITS, CTR_BITS> counters;
+
+public:
+    void Init() { counters.Init(); }
+
+    bool Predict(UINT32 PC) const { return counters.Predict(PC); }
+
+    void Update(UINT32 PC, bool resolveDir) { counters.Update(PC, resolveDir); }
+
+    struct SPEC {};
+
+    bool PredictSpec(UINT32 PC, SPEC *spec) const { return Predict(PC); }
+    void PushHistory(UINT32 PC, bool dir) {}
+    void RestoreHistory(UINT32 PC, const SPEC &spec) {}
+    void Train(UINT32 PC, bool resolveDir, const SPEC &spec) { Update(PC, resolveDir); }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        DescribeCounters<decltype(counters)>(s, p + "counters");
     }
-}
+};
+
+/////////////////////////////////////////////////////////////
+// 2level (PAp): 2^BHT_BITS local histories selected by the PC bits
+// above the 2^SET_BITS PHTs, which are selected by the lowest PC bits
+/////////////////////////////////////////////////////////////
+template <int BHT_BITS, int HIST_BITS, int SET_BITS, int CTR_BITS>
+class TWOLEVEL {
+    static constexpr UINT32 BHT_MASK  = (1u << BHT_BITS) - 1;
+    static constexpr UINT32 HIST_MASK = (1u << HIST_BITS) - 1;
+    static constexpr UINT32 SET_MASK  = (1u << SET_BITS) - 1;
 
-void UpdatePredictor_2bitsat(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
-    int i = PC & 0xFFF;
-    int val = prediction_table[i];
+    typename UINT_FOR<HIST_BITS>::type BHT[1u << BHT_BITS];
 
-    if (resolveDir == TAKEN && val < 3) {
-        val++;
-    } else if (resolveDir == NOT_TAKEN && val > 0) {
-        val--;
+    // the PHT sets laid out back to back, set-major
+    SAT_COUNTER_TABLE<SET_BITS + HIST_BITS, CTR_BITS> PHTs;
+
+    static UINT32 BHTIndex(UINT32 PC) { return (PC >> SET_BITS) & BHT_MASK; }
+
+    static UINT32 PHTIndex(UINT32 PC, UINT32 hist) {
+        return ((PC & SET_MASK) << HIST_BITS) | hist;
     }
 
-    prediction_table[i] = val;
-}
+public:
+    void Init() {
+        for (UINT32 i = 0; i <= BHT_MASK; i++) {
+            BHT[i] = 0;
+        }
+        PHTs.Init();
+    }
+
+    bool Predict(UINT32 PC) const { return PHTs.Predict(PHTIndex(PC, BHT[BHTIndex(PC)])); }
+
+    void Update(UINT32 PC, bool resolveDir) {
+        PHTs.Update(PHTIndex(PC, BHT[BHTIndex(PC)]), resolveDir);
+        PushHistory(PC, resolveDir);
+    }
+
+    // the branch's own local history
+    struct SPEC { UINT32 hist; };
+
+    bool PredictSpec(UINT32 PC, SPEC *spec) const {
+        spec->hist = BHT[BHTIndex(PC)];
+        return PHTs.Predict(PHTIndex(PC, spec->hist));
+    }
+
+    void PushHistory(UINT32 PC, bool dir) {
+        UINT32 i = BHTIndex(PC);
+        BHT[i] = ((BHT[i] << 1) | dir) & HIST_MASK;
+    }
+
+    void RestoreHistory(UINT32 PC, const SPEC &spec) { BHT[BHTIndex(PC)] = spec.hist; }
+
+    void Train(UINT32 PC, bool resolveDir, const SPEC &spec) {
+        PHTs.Update(PHTIndex(PC, spec.hist), resolveDir);
+    }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        s->Add(p + "BHT", 1u << BHT_BITS, HIST_BITS);
+        DescribeCounters<decltype(PHTs)>(s, p + "PHTs");
+    }
+};
+
+/////////////////////////////////////////////////////////////
+// gshare: HIST_BITS of global history XORed with the low PC bits
+/////////////////////////////////////////////////////////////
+template <int HIST_BITS, int IDX_BITS, int CTR_BITS>
+class GSHARE {
+    static constexpr UINT32 HIST_MASK = (1u << HIST_BITS) - 1;
+
+    SAT_COUNTER_TABLE<IDX_BITS, CTR_BITS> counters;
+    UINT32 history;
+
+public:
+    void Init() {
+        counters.Init();
+        history = 0;
+    }
+
+    bool Predict(UINT32 PC) const { return counters.Predict(history ^ PC); }
+
+    void Update(UINT32 PC, bool resolveDir) {
+        counters.Update(history ^ PC, resolveDir);
+        PushHistory(PC, resolveDir);
+    }
+
+    struct SPEC { UINT32 history; };
+
+    bool PredictSpec(UINT32 PC, SPEC *spec) const {
+        spec->history = history;
+        return Predict(PC);
+    }
+
+    void PushHistory(UINT32 PC, bool dir) { history = ((history << 1) | dir) & HIST_MASK; }
+
+    void RestoreHistory(UINT32 PC, const SPEC &spec) { history = spec.history; }
+
+    void Train(UINT32 PC, bool resolveDir, const SPEC &spec) {
+        counters.Update(spec.history ^ PC, resolveDir);
+    }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        DescribeCounters<decltype(counters)>(s, p + "counters");
+        s->Add(p + "history", 1, HIST_BITS);
+    }
+};
 
 /////////////////////////////////////////////////////////////
-// 2level
+// tournament: a table of 2^SEL_BITS counters picks P0 (low half)
+// or P1 (high half), trained toward whichever one was right
 /////////////////////////////////////////////////////////////
-struct PHT {
-    int counters[64];
+template <class P0, class P1, int SEL_BITS, int CTR_BITS>
+class TOURNAMENT {
+    P0 pred0;
+    P1 pred1;
+    SAT_COUNTER_TABLE<SEL_BITS, CTR_BITS> selector;
+
+public:
+    void Init() {
+        pred0.Init();
+        pred1.Init();
+        selector.Init();
+    }
+
+    bool Predict(UINT32 PC) const {
+        return selector.Predict(PC) ? pred1.Predict(PC) : pred0.Predict(PC);
+    }
+
+    void Update(UINT32 PC, bool resolveDir) {
+        // Find correctness of predictors
+        bool correct0 = pred0.Predict(PC) == resolveDir;
+        bool correct1 = pred1.Predict(PC) == resolveDir;
+
+        // Update selector based on correctness
+        if (correct0 != correct1) {
+            selector.Update(PC, correct1);
+        }
+
+        pred0.Update(PC, resolveDir);
+        pred1.Update(PC, resolveDir);
+    }
+
+    struct SPEC {
+        typename P0::SPEC spec0;
+        typename P1::SPEC spec1;
+        bool              dir0;
+        bool              dir1;
+    };
+
+    bool PredictSpec(UINT32 PC, SPEC *spec) {
+        spec->dir0 = pred0.PredictSpec(PC, &spec->spec0);
+        spec->dir1 = pred1.PredictSpec(PC, &spec->spec1);
+        return selector.Predict(PC) ? spec->dir1 : spec->dir0;
+    }
+
+    void PushHistory(UINT32 PC, bool dir) {
+        pred0.PushHistory(PC, dir);
+        pred1.PushHistory(PC, dir);
+    }
+
+    void RestoreHistory(UINT32 PC, const SPEC &spec) {
+        pred0.RestoreHistory(PC, spec.spec0);
+        pred1.RestoreHistory(PC, spec.spec1);
+    }
+
+    void Train(UINT32 PC, bool resolveDir, const SPEC &spec) {
+        if ((spec.dir0 == resolveDir) != (spec.dir1 == resolveDir)) {
+            selector.Update(PC, spec.dir1 == resolveDir);
+        }
+        pred0.Train(PC, resolveDir, spec.spec0);
+        pred1.Train(PC, resolveDir, spec.spec1);
+    }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        pred0.DescribeState(s, p + "p0.");
+        pred1.DescribeState(s, p + "p1.");
+        DescribeCounters<decltype(selector)>(s, p + "selector");
+    }
 };
 
-int BHT[512];
+/////////////////////////////////////////////////////////////
+// TAGE: a bimodal base plus NUM_TABLES partially tagged tables indexed
+// with geometrically increasing global history lengths between
+// MIN_HIST and MAX_HIST. The longest hitting table provides the
+// prediction; a mispredict allocates an entry in a longer table.
+/////////////////////////////////////////////////////////////
+template <int NUM_TABLES, int LOG_TABLE, int TAG_BITS, int MIN_HIST, int MAX_HIST, int LOG_BASE>
+class TAGE {
+    static constexpr int    LOG_HIST_BUF = 11;
+    static_assert(MAX_HIST < (1 << LOG_HIST_BUF), "history longer than the buffer");
+
+    static constexpr UINT32 TABLE_MASK = (1u << LOG_TABLE) - 1;
+    static constexpr UINT32 TAG_MASK   = (1u << TAG_BITS) - 1;
+    static constexpr int    CTR_MAX    = 3;      // 3-bit signed counters
+    static constexpr int    CTR_MIN    = -4;
+    static constexpr int    U_MAX      = 3;      // 2-bit useful counters
+    static constexpr UINT64 U_RESET    = (1ULL << 18) - 1;
+
+    struct ENTRY {
+        signed char    ctr;
+        UINT8          u;
+        unsigned short tag;
+    };
+
+    SAT_COUNTER_TABLE<LOG_BASE, 2> base;
+    ENTRY tables[NUM_TABLES][1u << LOG_TABLE];
+
+    GLOBAL_HISTORY<LOG_HIST_BUF> ghist;
+    FOLDED_HISTORY idxFold[NUM_TABLES];
+    FOLDED_HISTORY tagFold0[NUM_TABLES];
+    FOLDED_HISTORY tagFold1[NUM_TABLES];
+    int    histLen[NUM_TABLES];
+    UINT32 pathMask[NUM_TABLES];   // path bits folded into each index
+    int    pcShift[NUM_TABLES];    // per-table PC hash shift
+    UINT32 phist;          // 16 bits of path history
+    int    useAltOnNa;     // 4-bit signed: trust alt over a weak new entry
+    UINT64 numBranches;    // drives the periodic useful-bit decay
+    UINT32 seed;           // pseudo-random allocation choice
+
+    // filled by Lookup, reused by Update for the same branch
+    struct LOOKUP {
+        UINT32 PC;
+        bool   valid;
+        UINT32 idx[NUM_TABLES];
+        UINT32 tag[NUM_TABLES];
+        int    provider;   // -1: base
+        int    alt;        // -1: base
+        bool   providerPred;
+        bool   altPred;
+        bool   weak;
+        bool   pred;
+    } look;
+
+    void Lookup(UINT32 PC) {
+        int i;
+
+        for (i = 0; i < NUM_TABLES; i++) {
+            UINT32 path = phist & pathMask[i];
+            look.idx[i] = (PC ^ (PC >> pcShift[i]) ^ idxFold[i].comp ^ path ^ (path >> LOG_TABLE)) & TABLE_MASK;
+            look.tag[i] = (PC ^ tagFold0[i].comp ^ (tagFold1[i].comp << 1)) & TAG_MASK;
+        }
 
-PHT PHTs[8];
+        // hit bitmap instead of an early-exit search: the host cannot
+        // predict which tables hit
+        UINT32 hits = 0;
+        for (i = 0; i < NUM_TABLES; i++) {
+            hits |= (UINT32) (tables[i][look.idx[i]].tag == look.tag[i]) << i;
+        }
+        look.provider = hits ? 31 - __builtin_clz(hits) : -1;
+        hits &= ~(1u << (look.provider & 31));
+        look.alt = hits ? 31 - __builtin_clz(hits) : -1;
+
+        bool basePred = base.Predict(PC);
+        look.altPred = look.alt >= 0 ? tables[look.alt][look.idx[look.alt]].ctr >= 0 : basePred;
+
+        if (look.provider >= 0) {
+            int ctr = tables[look.provider][look.idx[look.provider]].ctr;
+            look.providerPred = ctr >= 0;
+            look.weak = (ctr == 0 || ctr == -1);
+            look.pred = (look.weak && useAltOnNa >= 0) ? look.altPred : look.providerPred;
+        } else {
+            look.providerPred = basePred;
+            look.weak = false;
+            look.pred = basePred;
+        }
 
-// SIZE IS: 512*6 + 8*64*2 = 3072 bits + 1024 bits = 4KB
+        look.PC = PC;
+        look.valid = true;
+    }
 
-void InitPredictor_2level() {
-    int i, j, k;
+    static void CtrUpdate(signed char *ctr, bool resolveDir) {
+        if (resolveDir) {
+            if (*ctr < CTR_MAX) (*ctr)++;
+        } else {
+            if (*ctr > CTR_MIN) (*ctr)--;
+        }
+    }
 
-    for (i = 0; i < 512; i++) {
-        BHT[i] = 0;
+    // trains the tables on the outcome of a branch looked up as l
+    void Learn(UINT32 PC, bool resolveDir, const LOOKUP &l) {
+        int i;
+
+        // learn whether a weak, newly allocated provider beats its alt
+        if (l.provider >= 0 && l.weak && l.providerPred != l.altPred) {
+            if (l.altPred == resolveDir) {
+                if (useAltOnNa < 7) useAltOnNa++;
+            } else {
+                if (useAltOnNa > -8) useAltOnNa--;
+            }
+        }
+
+        // on a mispredict grab a not-useful entry in a longer table
+        if (l.pred != resolveDir && l.provider < NUM_TABLES - 1) {
+            seed = seed * 1103515245 + 12345;
+            int start = l.provider + 1 + ((seed >> 16) & 1);
+            bool allocated = false;
+
+            for (i = min(start, NUM_TABLES - 1); i < NUM_TABLES; i++) {
+                ENTRY *e = &tables[i][l.idx[i]];
+                if (e->u == 0) {
+                    e->tag = l.tag[i];
+                    e->ctr = resolveDir ? 0 : -1;
+                    allocated = true;
+                    break;
+                }
+            }
+            if (!allocated) {
+                for (i = l.provider + 1; i < NUM_TABLES; i++) {
+                    ENTRY *e = &tables[i][l.idx[i]];
+                    if (e->u > 0) e->u--;
+                }
+            }
+        }
+
+        if (l.provider >= 0) {
+            ENTRY *e = &tables[l.provider][l.idx[l.provider]];
+            CtrUpdate(&e->ctr, resolveDir);
+
+            if (l.providerPred != l.altPred) {
+                if (l.providerPred == resolveDir) {
+                    if (e->u < U_MAX) e->u++;
+                } else {
+                    if (e->u > 0) e->u--;
+                }
+            }
+        } else {
+            base.Update(PC, resolveDir);
+        }
+
+        // age the useful bits so stale entries can be replaced
+        if ((++numBranches & U_RESET) == 0) {
+            for (i = 0; i < NUM_TABLES; i++) {
+                for (UINT32 j = 0; j <= TABLE_MASK; j++) {
+                    tables[i][j].u >>= 1;
+                }
+            }
+        }
     }
 
-    for (j = 0; j < 8; j++) {
-        for (k = 0; k < 64; k++) {
-            PHTs[j].counters[k] = 1;
+public:
+    void Init() {
+        base.Init();
+        memset(tables, 0, sizeof(tables));
+        ghist.Init();
+
+        for (int i = 0; i < NUM_TABLES; i++) {
+            double ratio = NUM_TABLES > 1 ? (double) i / (NUM_TABLES - 1) : 0;
+            histLen[i] = (int) (MIN_HIST * pow((double) MAX_HIST / MIN_HIST, ratio) + 0.5);
+            pathMask[i] = (1u << min(histLen[i], 16)) - 1;
+            pcShift[i] = LOG_TABLE - (i % LOG_TABLE);
+            idxFold[i].Init(histLen[i], LOG_TABLE);
+            tagFold0[i].Init(histLen[i], TAG_BITS);
+            tagFold1[i].Init(histLen[i], TAG_BITS - 1);
         }
+
+        phist = 0;
+        useAltOnNa = 0;
+        numBranches = 0;
+        seed = 0x2545F491;
+        look.valid = false;
     }
-}
 
-bool GetPrediction_2level(UINT32 PC) {
-    int i = (PC & 0xFF8) >> 3;
-    int j = PC & 0x7;
-    int his = BHT[i] & 0x3F;
+    bool Predict(UINT32 PC) {
+        Lookup(PC);
+        return look.pred;
+    }
 
-    if (PHTs[j].counters[his] <= 1) {
-        return NOT_TAKEN;
-    } else {
-        return TAKEN;
+    void Update(UINT32 PC, bool resolveDir) {
+        if (!look.valid || look.PC != PC) {
+            Lookup(PC);
+        }
+        Learn(PC, resolveDir, look);
+        PushHistory(PC, resolveDir);
+        look.valid = false;
     }
-}
 
-void UpdatePredictor_2level(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
-    int i = (PC & 0xFF8) >> 3;
-    int j = PC & 0x7;
-    int his = BHT[i] & 0x3F;
-    int val = PHTs[j].counters[his];
+    struct SPEC {
+        LOOKUP look;
+        UINT32 ghistPos;
+        UINT32 idxComp[NUM_TABLES];
+        UINT32 tagComp0[NUM_TABLES];
+        UINT32 tagComp1[NUM_TABLES];
+        UINT32 phist;
+    };
+
+    bool PredictSpec(UINT32 PC, SPEC *spec) {
+        Lookup(PC);
+        look.valid = false;
+        spec->look = look;
+
+        spec->ghistPos = ghist.Checkpoint();
+        for (int i = 0; i < NUM_TABLES; i++) {
+            spec->idxComp[i] = idxFold[i].comp;
+            spec->tagComp0[i] = tagFold0[i].comp;
+            spec->tagComp1[i] = tagFold1[i].comp;
+        }
+        spec->phist = phist;
+        return look.pred;
+    }
 
-    // Update value
-    if (resolveDir == TAKEN && val < 3) {
-        val++;
-    } else if (resolveDir == NOT_TAKEN && val > 0) {
-        val--;
+    void PushHistory(UINT32 PC, bool dir) {
+        ghist.Push(dir);
+        for (int i = 0; i < NUM_TABLES; i++) {
+            idxFold[i].Update(ghist);
+            tagFold0[i].Update(ghist);
+            tagFold1[i].Update(ghist);
+        }
+        phist = ((phist << 1) | (PC & 1)) & 0xFFFF;
     }
-    PHTs[j].counters[his] = val;
 
-    //Update history
-    BHT[i] = (his << 1) + resolveDir;
-}
+    void RestoreHistory(UINT32 PC, const SPEC &spec) {
+        ghist.Rewind(spec.ghistPos);
+        for (int i = 0; i < NUM_TABLES; i++) {
+            idxFold[i].comp = spec.idxComp[i];
+            tagFold0[i].comp = spec.tagComp0[i];
+            tagFold1[i].comp = spec.tagComp1[i];
+        }
+        phist = spec.phist;
+    }
+
+    void Train(UINT32 PC, bool resolveDir, const SPEC &spec) { Learn(PC, resolveDir, spec.look); }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        DescribeCounters<decltype(base)>(s, p + "base");
+        for (int i = 0; i < NUM_TABLES; i++) {
+            s->Add(p + "T" + to_string(i + 1), 1u << LOG_TABLE, 3 + 2 + TAG_BITS);
+        }
+        s->Add(p + "ghist", 1, MAX_HIST);
+        s->Add(p + "folded", NUM_TABLES, LOG_TABLE + TAG_BITS + TAG_BITS - 1);
+        s->Add(p + "phist", 1, 16);
+        s->Add(p + "useAltOnNa", 1, 4);
+        s->Add(p + "uResetCount", 1, 18);
+        s->Add(p + "allocLFSR", 1, 32);
+    }
+};
+
+/////////////////////////////////////////////////////////////
+// hashed perceptron: NUM_TABLES tables of 8-bit weights, table 0
+// indexed by PC alone, table i by PC hashed with a geometric slice of
+// global history up to MAX_HIST. Predicts taken if the weight sum is
+// non-negative and trains on mispredicts or low-confidence sums.
+/////////////////////////////////////////////////////////////
+template <int NUM_TABLES, int LOG_TABLE, int MAX_HIST>
+class HASHED_PERCEPTRON {
+    static constexpr int    LOG_HIST_BUF = 11;
+    static_assert(MAX_HIST < (1 << LOG_HIST_BUF), "history longer than the buffer");
+
+    static constexpr UINT32 TABLE_MASK = (1u << LOG_TABLE) - 1;
+    static constexpr int    W_MAX      = 127;
+    static constexpr int    W_MIN      = -128;
+
+    signed char weights[NUM_TABLES][1u << LOG_TABLE];
+
+    GLOBAL_HISTORY<LOG_HIST_BUF> ghist;
+    FOLDED_HISTORY fold[NUM_TABLES];
+    int    theta;          // training threshold, adapted at run time
+    int    thetaCount;     // 7-bit signed
+
+    // filled by Lookup, reused by Update for the same branch
+    struct LOOKUP {
+        UINT32 PC;
+        bool   valid;
+        UINT32 idx[NUM_TABLES];
+        int    sum;
+    } look;
+
+    void Lookup(UINT32 PC) {
+        look.sum = 0;
+        for (int i = 0; i < NUM_TABLES; i++) {
+            look.idx[i] = (PC ^ (PC >> (i + 1)) ^ fold[i].comp) & TABLE_MASK;
+            look.sum += weights[i][look.idx[i]];
+        }
+        look.PC = PC;
+        look.valid = true;
+    }
+
+    // trains the weights on the outcome of a branch looked up as l
+    void Learn(bool resolveDir, const LOOKUP &l) {
+        int i;
+
+        bool pred = l.sum >= 0;
+        int  mag = l.sum < 0 ? -l.sum : l.sum;
+
+        if (pred != resolveDir || mag <= theta) {
+            for (i = 0; i < NUM_TABLES; i++) {
+                signed char *w = &weights[i][l.idx[i]];
+                if (resolveDir) {
+                    if (*w < W_MAX) (*w)++;
+                } else {
+                    if (*w > W_MIN) (*w)--;
+                }
+            }
+
+            // keep mispredict and low-confidence training in balance
+            if (pred != resolveDir) {
+                if (++thetaCount >= 63) { theta++; thetaCount = 0; }
+            } else {
+                if (--thetaCount <= -64) { theta--; thetaCount = 0; }
+            }
+        }
+    }
+
+public:
+    void Init() {
+        memset(weights, 0, sizeof(weights));
+        ghist.Init();
+
+        // table 0 sees no history, table i sees a geometric share of MAX_HIST
+        fold[0].Init(0, LOG_TABLE);
+        for (int i = 1; i < NUM_TABLES; i++) {
+            double ratio = NUM_TABLES > 2 ? (double) (i - 1) / (NUM_TABLES - 2) : 1;
+            fold[i].Init((int) (2 * pow((double) MAX_HIST / 2, ratio) + 0.5), LOG_TABLE);
+        }
+
+        theta = (int) (1.93 * NUM_TABLES + 14);
+        thetaCount = 0;
+        look.valid = false;
+    }
+
+    bool Predict(UINT32 PC) {
+        Lookup(PC);
+        return look.sum >= 0;
+    }
+
+    void Update(UINT32 PC, bool resolveDir) {
+        if (!look.valid || look.PC != PC) {
+            Lookup(PC);
+        }
+        Learn(resolveDir, look);
+        PushHistory(PC, resolveDir);
+        look.valid = false;
+    }
+
+    struct SPEC {
+        LOOKUP look;
+        UINT32 ghistPos;
+        UINT32 comp[NUM_TABLES];
+    };
+
+    bool PredictSpec(UINT32 PC, SPEC *spec) {
+        Lookup(PC);
+        look.valid = false;
+        spec->look = look;
+
+        spec->ghistPos = ghist.Checkpoint();
+        for (int i = 0; i < NUM_TABLES; i++) {
+            spec->comp[i] = fold[i].comp;
+        }
+        return look.sum >= 0;
+    }
+
+    void PushHistory(UINT32 PC, bool dir) {
+        ghist.Push(dir);
+        for (int i = 1; i < NUM_TABLES; i++) {
+            fold[i].Update(ghist);
+        }
+    }
+
+    void RestoreHistory(UINT32 PC, const SPEC &spec) {
+        ghist.Rewind(spec.ghistPos);
+        for (int i = 0; i < NUM_TABLES; i++) {
+            fold[i].comp = spec.comp[i];
+        }
+    }
+
+    void Train(UINT32 PC, bool resolveDir, const SPEC &spec) { Learn(resolveDir, spec.look); }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        s->Add(p + "weights", NUM_TABLES << LOG_TABLE, 8);
+        s->Add(p + "ghist", 1, MAX_HIST);
+        s->Add(p + "folded", NUM_TABLES - 1, LOG_TABLE);
+        s->Add(p + "theta", 1, 8);
+        s->Add(p + "thetaCount", 1, 7);
+    }
+};
 
 /////////////////////////////////////////////////////////////
-// openend (hybrid branch predictor)
+// bimodal bank: 8 bimodal tables of 2^LOG_MIN .. 2^(LOG_MIN+7)
+// counters run in lock-step, one configuration per byte lane
 /////////////////////////////////////////////////////////////
-struct PHTbig {
-    int counters[256];
+
+// The tables are stored structure-of-arrays, one byte per counter. For
+// each branch the eight counters are gathered into one UINT64, predicted
+// and updated together with SWAR arithmetic, and scattered back. Lane l
+// behaves exactly like BIMODAL<LOG_MIN + l, CTR_BITS>.
+
+template <int LOG_MIN, int CTR_BITS>
+class BIMODAL_BANK {
+public:
+    static constexpr int    LANES    = 8;
+    static constexpr UINT64 LSB      = SwarLaneLsb(8, LANES);
+    static constexpr UINT32 CTR_INIT = ((1u << CTR_BITS) - 1) >> 1;
+    static constexpr UINT32 ENTRIES  = (1u << (LOG_MIN + LANES)) - (1u << LOG_MIN);
+
+private:
+    UINT8 counters[ENTRIES];
+
+    static UINT32 Offset(int l) { return (1u << (LOG_MIN + l)) - (1u << LOG_MIN); }
+    static UINT32 Mask(int l)   { return (1u << (LOG_MIN + l)) - 1; }
+
+    UINT64 Gather(UINT32 PC) const {
+        UINT64 v = 0;
+        for (int l = 0; l < LANES; l++) {
+            v |= (UINT64) counters[Offset(l) + (PC & Mask(l))] << (8 * l);
+        }
+        return v;
+    }
+
+    void Scatter(UINT32 PC, UINT64 v) {
+        for (int l = 0; l < LANES; l++) {
+            counters[Offset(l) + (PC & Mask(l))] = v >> (8 * l);
+        }
+    }
+
+    // the counters use only the low CTR_BITS of each byte, so bits shifted
+    // in from the lane above never reach a lane's lowest bit
+    static UINT64 Saturated(UINT64 v) {
+        UINT64 t = v;
+        for (int b = 1; b < CTR_BITS; b++) {
+            t &= v >> b;
+        }
+        return t & LSB;
+    }
+
+    static UINT64 Zero(UINT64 v) {
+        UINT64 t = v;
+        for (int b = 1; b < CTR_BITS; b++) {
+            t |= v >> b;
+        }
+        return ~t & LSB;
+    }
+
+public:
+    void Init() { memset(counters, CTR_INIT, sizeof(counters)); }
+
+    // lowest bit of every lane predicting taken (upper half of the range)
+    UINT64 Predict(UINT32 PC) const { return (Gather(PC) >> (CTR_BITS - 1)) & LSB; }
+
+    // returns the lowest bit of every lane that mispredicted
+    UINT64 Run(UINT32 PC, bool resolveDir) {
+        UINT64 v = Gather(PC);
+        UINT64 dir = resolveDir ? LSB : 0;
+        UINT64 wrong = ((v >> (CTR_BITS - 1)) & LSB) ^ dir;
+
+        v = resolveDir ? v + (LSB & ~Saturated(v)) : v - (LSB & ~Zero(v));
+        Scatter(PC, v);
+        return wrong;
+    }
+
+    // lanes are named by their index bits: lane "10" is bimodal-10
+    static string LaneName(int l) { return to_string(LOG_MIN + l); }
+
+    void DescribeLane(int l, CBP_STATE *s, const string &p) const {
+        s->Add(p + "counters", 1u << (LOG_MIN + l), CTR_BITS);
+    }
+
+    void DescribeState(CBP_STATE *s, const string &p) const {
+        for (int l = 0; l < LANES; l++) {
+            DescribeLane(l, s, p + "lane" + to_string(l) + ".");
+        }
+    }
 };
 
-// gshare predictor counters
-int counters[32768];   
-// Upscaled 2-level
-int BHTopen[4096];
-PHTbig PHTsopen[16];
-// selector
-int selector[8192];
-// 15 bit history, used with gshare
-int history;
+/////////////////////////////////////////////////////////////
+// adapter from a template predictor to the registry interface
+/////////////////////////////////////////////////////////////
+template <class P>
+class PREDICTOR : public CBP_PREDICTOR {
+    // every component is fixed-size and pointer-free, so its bytes are its state
+    static_assert(std::is_trivially_copyable<P>::value, "predictor state must be plain data");
+
+    // Delayed update: branches predicted but not yet trained, oldest
+    // first. The histories already hold each one's predicted direction.
+    // A branch is trained once `delay` younger ones have been predicted;
+    // a mispredicted one repairs the histories and, as the flush would
+    // leave nothing in flight behind it, trains the whole queue.
+    struct PENDING {
+        UINT32 PC;
+        bool   pred;
+        bool   resolveDir;
+        typename P::SPEC spec;
+    };
+    struct DELAY_QUEUE {
+        PENDING slot[CBP_MAX_UPDATE_DELAY + 1];
+        int     head;
+        int     count;
+    };
+
+    P           impl;
+    DELAY_QUEUE queue;
+    int         delay;
+
+    bool Speculate(UINT32 PC) {
+        PENDING *e = &queue.slot[(queue.head + queue.count) % (CBP_MAX_UPDATE_DELAY + 1)];
+
+        e->PC = PC;
+        e->pred = impl.PredictSpec(PC, &e->spec);
+        impl.PushHistory(PC, e->pred);
+        queue.count++;
+        return e->pred;
+    }
+
+    // resolves the youngest pending branch
+    void Resolve(bool resolveDir) {
+        PENDING *e = &queue.slot[(queue.head + queue.count - 1) % (CBP_MAX_UPDATE_DELAY + 1)];
+
+        e->resolveDir = resolveDir;
+        if (e->pred != resolveDir) {
+            impl.RestoreHistory(e->PC, e->spec);
+            impl.PushHistory(e->PC, resolveDir);
+            Retire(queue.count);
+        } else if (queue.count > delay) {
+            Retire(queue.count - delay);
+        }
+    }
 
-// SIZE IS: 32768*2 + 4096*8  + 16*256*2 + 8192*2 + 15 = 120KB + 15 bits
+    void Retire(int n) {
+        for (; n > 0; n--) {
+            const PENDING &e = queue.slot[queue.head];
 
-void InitPredictor_openend() {
-    int i, j, k;
+            impl.Train(e.PC, e.resolveDir, e.spec);
+            queue.head = (queue.head + 1) % (CBP_MAX_UPDATE_DELAY + 1);
+            queue.count--;
+        }
+    }
+
+public:
+    PREDICTOR() : delay(0) { queue.head = queue.count = 0; }
 
-    // initialize gshare prediction
-    for (i = 0; i < 32768; i++) {
-        counters[i] = 1;
+    void Init() {
+        impl.Init();
+        queue.head = queue.count = 0;
     }
-    history = 0;
 
+    bool GetPrediction(UINT32 PC) {
+        if (delay > 0) {
+            return Speculate(PC) ? TAKEN : NOT_TAKEN;
+        }
+        return impl.Predict(PC) ? TAKEN : NOT_TAKEN;
+    }
 
-    // initialize 2level
-    for (i = 0; i < 4096; i++) {
-        BHTopen[i] = 0;
+    void UpdatePredictor(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+        if (delay > 0) {
+            Resolve(resolveDir);
+            return;
+        }
+        impl.Update(PC, resolveDir);
     }
-    for (j = 0; j < 16; j++) {
-        for (k = 0; k < 256; k++) {
-            PHTs[j].counters[k] = 1;
+
+    bool SetUpdateDelay(int branches) {
+        if (branches < 0 || branches > CBP_MAX_UPDATE_DELAY) {
+            return false;
         }
+        Retire(queue.count);
+        delay = branches;
+        return true;
     }
 
-    // initialize selector
-    for (i = 0; i < 8192; i++) {
-        selector[i] = 1;
+    void DescribeState(CBP_STATE *state) { impl.DescribeState(state, ""); }
+
+    UINT64 GetStateBytes() { return sizeof(impl) + sizeof(queue); }
+
+    void SaveState(void *buf) {
+        memcpy(buf, &impl, sizeof(impl));
+        memcpy((char *) buf + sizeof(impl), &queue, sizeof(queue));
     }
-}
 
-bool GetPrediction_openend(UINT32 PC) {
-    int val;
-    // Selector chooses based on 2bit sat counters that are selected using least significant 13 bits
-    if (selector[PC & 0x1FFF] <= 1) {
-        // use gshare prediction, which indexes into a table of 2 bit sat counters using the XOR of the global history and the current PC
-        val = counters[(history & 0x7FFF) ^ (PC & 0x7FFF)];
-    } else {
-        // use 2level prediction
-        val = PHTsopen[PC & 0xF].counters[BHTopen[(PC & 0xFFF0) >> 4] & 0xFF];
+    void RestoreState(const void *buf) {
+        memcpy(&impl, buf, sizeof(impl));
+        memcpy(&queue, (const char *) buf + sizeof(impl), sizeof(queue));
     }
 
-    if (val <= 1) {
-        return NOT_TAKEN;
-    } else {
-        return TAKEN;
+    void RunBatch(const CBP_TRACE_RECORD *rec, int count, UINT64 *numMispred) {
+        UINT64 wrong = 0;
+
+        if (delay > 0) {
+            for (int i = 0; i < count; i++) {
+                bool predDir = Speculate(rec[i].PC);
+                Resolve(rec[i].branchTaken);
+                wrong += predDir != rec[i].branchTaken;
+            }
+        } else {
+            for (int i = 0; i < count; i++) {
+                bool predDir = impl.Predict(rec[i].PC);
+                impl.Update(rec[i].PC, rec[i].branchTaken);
+                wrong += predDir != rec[i].branchTaken;
+            }
+        }
+        numMispred[0] += wrong;
     }
-}
+};
 
-void UpdatePredictor_openend(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
-    
-    // Find correctness of predictors
-    int index = (history & 0x7FFF) ^ (PC & 0x7FFF); 
-    int val = counters[index];  // gshare prediction
+/////////////////////////////////////////////////////////////
+// adapter from a lock-step bank (BIMODAL_BANK) to the registry
+/////////////////////////////////////////////////////////////
+template <class B>
+class BANK_PREDICTOR : public CBP_PREDICTOR {
+    static_assert(std::is_trivially_copyable<B>::value, "predictor state must be plain data");
 
-    int i = (PC & 0xFFF0) >> 4;
-    int j = PC & 0xF;
-    int his = BHTopen[i] & 0xFF;
-    int val2 = PHTsopen[j].counters[his];     // 2level prediction
+    B impl;
 
-    bool correct = false;
-    bool correct2 = false;
-    if ((val <= 1 && !resolveDir) || (val > 1 && resolveDir)) {
-        correct = true; 
+public:
+    void Init() { impl.Init(); }
+
+    // single-branch calls see lane 0; use RunBatch for every lane
+    bool GetPrediction(UINT32 PC) { return impl.Predict(PC) & 1; }
+
+    void UpdatePredictor(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget) {
+        impl.Run(PC, resolveDir);
     }
-    if ((val2 <= 1 && !resolveDir) || (val2 > 1 && resolveDir)) {
-        correct2 = true;
+
+    void DescribeState(CBP_STATE *state) { impl.DescribeState(state, ""); }
+
+    UINT64 GetStateBytes() { return sizeof(impl); }
+    void   SaveState(void *buf) { memcpy(buf, &impl, sizeof(impl)); }
+    void   RestoreState(const void *buf) { memcpy(&impl, buf, sizeof(impl)); }
+
+    // per-lane mispredictions are summed in byte lanes and flushed
+    // before any lane can overflow
+    void RunBatch(const CBP_TRACE_RECORD *rec, int count, UINT64 *numMispred) {
+        for (int i = 0; i < count; ) {
+            int    end = min(count, i + 255);
+            UINT64 acc = 0;
+
+            for (; i < end; i++) {
+                acc += impl.Run(rec[i].PC, rec[i].branchTaken);
+            }
+            for (int l = 0; l < B::LANES; l++) {
+                numMispred[l] += (acc >> (8 * l)) & 0xff;
+            }
+        }
     }
 
-    // Update selector based on correctness
-    int k = PC & 0x1FFF;
-    if (correct2 && !correct) {
-        selector[k]++; 
-    } else if (correct && !correct2) {
-        selector[k]--;
+    int    NumLanes() { return B::LANES; }
+    string GetLaneName(int lane) { return B::LaneName(lane); }
+
+    UINT64 GetLaneBudgetBits(int lane) {
+        CBP_STATE state;
+        impl.DescribeLane(lane, &state, "");
+        return state.GetTotalBits();
     }
+};
+
+/////////////////////////////////////////////////////////////
+// configurations (predictor -state <name> prints the storage of each)
+/////////////////////////////////////////////////////////////
+
+// 2bitsat: 4096 2-bit counters
+typedef BIMODAL<12, 2> PREDICTOR_2BITSAT;
 
-    // Update gshare predictor
-    if (resolveDir == TAKEN && val < 3) {
-        val++;
-    } else if (resolveDir == NOT_TAKEN && val > 0) {
-        val--;
+// 2level: 512 6-bit histories, 8 PHTs of 64 2-bit counters
+typedef TWOLEVEL<9, 6, 3, 2> PREDICTOR_2LEVEL;
+
+// openend (hybrid branch predictor): 15-bit gshare against an upscaled
+// 2level (4096 8-bit histories, 16 PHTs of 256), 8192 selector counters
+typedef TOURNAMENT<GSHARE<15, 15, 2>, TWOLEVEL<12, 8, 4, 2>, 13, 2> PREDICTOR_OPENEND;
+
+// tage: 16K 2-bit base counters, 12 tables of 1K (3-bit ctr, 2-bit u,
+// 11-bit tag) entries, histories 4..640
+typedef TAGE<12, 10, 11, 4, 640, 14> PREDICTOR_TAGE;
+
+// tage-8k: 4K base counters, 7 tables of 512 (3+2+9)-bit entries, histories 4..130
+typedef TAGE<7, 9, 9, 4, 130, 12> PREDICTOR_TAGE_8K;
+
+// perceptron: 16 tables of 2K 8-bit weights, histories up to 512
+typedef HASHED_PERCEPTRON<16, 11, 512> PREDICTOR_PERCEPTRON;
+
+// perceptron-8k: 8 tables of 1K 8-bit weights, histories up to 128
+typedef HASHED_PERCEPTRON<8, 10, 128> PREDICTOR_PERCEPTRON_8K;
+
+/////////////////////////////////////////////////////////////
+// registry
+/////////////////////////////////////////////////////////////
+template <class P>
+static CBP_PREDICTOR *Create() {
+    return new PREDICTOR<P>();
+}
+
+template <class B>
+static CBP_PREDICTOR *CreateBank() {
+    return new BANK_PREDICTOR<B>();
+}
+
+static const CBP_PREDICTOR_ENTRY registry[] = {
+    { "2bitsat",    "4096-entry bimodal table of 2-bit counters",   Create<PREDICTOR_2BITSAT> },
+    { "2level",     "PAp: 512 6-bit local histories, 8 PHTs",        Create<PREDICTOR_2LEVEL>  },
+    { "openend",    "gshare + per-address 2-level tournament",      Create<PREDICTOR_OPENEND> },
+    { "tage",       "TAGE, 12 tagged tables, histories 4..640",     Create<PREDICTOR_TAGE>    },
+    { "tage-8k",    "TAGE, 7 tagged tables, histories 4..130",      Create<PREDICTOR_TAGE_8K> },
+    { "perceptron", "hashed perceptron, 16x2K weights, hist 512",   Create<PREDICTOR_PERCEPTRON> },
+    { "perceptron-8k", "hashed perceptron, 8x1K weights, hist 128", Create<PREDICTOR_PERCEPTRON_8K> },
+
+    // sweep points
+    { "bimodal-10", "1K-entry bimodal, 2-bit counters",             Create< BIMODAL<10, 2> >  },
+    { "bimodal-14", "16K-entry bimodal, 2-bit counters",            Create< BIMODAL<14, 2> >  },
+    { "bimodal-16", "64K-entry bimodal, 2-bit counters",            Create< BIMODAL<16, 2> >  },
+    { "bimodal-14x3", "16K-entry bimodal, 3-bit counters",          Create< BIMODAL<14, 3> >  },
+    { "gshare-10",  "gshare, 10-bit history, 1K counters",          Create< GSHARE<10, 10, 2> > },
+    { "gshare-12",  "gshare, 12-bit history, 4K counters",          Create< GSHARE<12, 12, 2> > },
+    { "gshare-14",  "gshare, 14-bit history, 16K counters",         Create< GSHARE<14, 14, 2> > },
+    { "gshare-15",  "gshare, 15-bit history, 32K counters",         Create< GSHARE<15, 15, 2> > },
+    { "gshare-16",  "gshare, 16-bit history, 64K counters",         Create< GSHARE<16, 16, 2> > },
+    { "gshare-8x14", "gshare, 8-bit history, 16K counters",         Create< GSHARE<8, 14, 2> >  },
+    { "2level-h8",  "PAp: 1024 8-bit local histories, 8 PHTs",      Create< TWOLEVEL<10, 8, 3, 2> > },
+    { "2level-h10", "PAp: 1024 10-bit local histories, 16 PHTs",    Create< TWOLEVEL<10, 10, 4, 2> > },
+    { "bimodal-bank", "bimodal 512..64K entries, 8 sizes in lock-step", CreateBank< BIMODAL_BANK<9, 2> > },
+    { "tourn-12",   "gshare-12 + 2level-h8 tournament, 4K selector", Create< TOURNAMENT<GSHARE<12, 12, 2>, TWOLEVEL<10, 8, 3, 2>, 12, 2> > },
+};
+
+int NumRegisteredPredictors() {
+    return sizeof(registry) / sizeof(registry[0]);
+}
+
+const CBP_PREDICTOR_ENTRY *GetRegisteredPredictor(int i) {
+    return &registry[i];
+}
+
+CBP_PREDICTOR *CreatePredictor(const char *name) {
+    for (int i = 0; i < NumRegisteredPredictors(); i++) {
+        if (strcmp(registry[i].name, name) == 0) {
+            return registry[i].create();
+        }
     }
-    counters[index] = val;
-    history = (history << 1) + resolveDir;
+    return NULL;
+}
 
-    // Update 2level predictor
-    if (resolveDir == TAKEN && val2 < 3) {
-        val2++;
-    } else if (resolveDir == NOT_TAKEN && val2 > 0) {
-        val2--;
+/////////////////////////////////////////////////////////////
+// default batch loop
+/////////////////////////////////////////////////////////////
+void CBP_PREDICTOR::RunBatch(const CBP_TRACE_RECORD *rec, int count, UINT64 *numMispred) {
+    for (int i = 0; i < count; i++) {
+        bool predDir = GetPrediction(rec[i].PC);
+        UpdatePredictor(rec[i].PC, rec[i].branchTaken, predDir, rec[i].branchTarget);
+        numMispred[0] += predDir != rec[i].branchTaken;
     }
-    PHTsopen[j].counters[his] = val2;
-    BHTopen[i] = (his << 1) + resolveDir;
 }
 
+/////////////////////////////////////////////////////////////
+// storage accounting
+/////////////////////////////////////////////////////////////
+void CBP_STATE::Add(const string &name, UINT64 entries, UINT32 bits) {
+    CBP_STATE_ENTRY e;
+    e.name = name;
+    e.entries = entries;
+    e.bits = bits;
+    this->entries.push_back(e);
+}
 
+UINT64 CBP_STATE::GetTotalBits() {
+    UINT64 total = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        total += entries[i].entries * entries[i].bits;
+    }
+    return total;
+}
@@ -1,26 +1,101 @@
+
 #ifndef _PREDICTOR_H_
 #define _PREDICTOR_H_
 
+#include <vector>
 #include "utils.h"
 #include "tracer.h"
 
 /////////////////////////////////////////////////////////////
 
-void InitPredictor_2bitsat();
-bool GetPrediction_2bitsat(UINT32 PC);  
-void UpdatePredictor_2bitsat(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+// Storage a predictor would need in hardware, declared table by table
+// (entries x bits per entry) rather than read off host data types.
+
+struct CBP_STATE_ENTRY{
+  string name;
+  UINT64 entries;
+  UINT32 bits;
+};
+
+class CBP_STATE{
+ private:
+  vector<CBP_STATE_ENTRY> entries;
+
+ public:
+  void   Add(const string &name, UINT64 entries, UINT32 bits);
+
+  int    NumEntries(){ return entries.size(); }
+  const  CBP_STATE_ENTRY *GetEntry(int i){ return &entries[i]; }
+  UINT64 GetTotalBits();
+};
 
 /////////////////////////////////////////////////////////////
 
-void InitPredictor_2level();
-bool GetPrediction_2level(UINT32 PC);  
-void UpdatePredictor_2level(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+#define CBP_MAX_UPDATE_DELAY 64    // conditional branches
+
+// Every predictor owns its tables, so any number of them (including
+// several of the same kind) can be fed from one trace pass.
+
+class CBP_PREDICTOR{
+ public:
+  virtual ~CBP_PREDICTOR(){}
+
+  virtual void Init()=0;
+  virtual bool GetPrediction(UINT32 PC)=0;
+  virtual void UpdatePredictor(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget)=0;
+
+  // appends every table and register the predictor keeps
+  virtual void DescribeState(CBP_STATE *state)=0;
+
+  // complete predictor state (tables, histories, selectors) as raw
+  // bytes, for checkpoints; only valid within one build of predictor
+  virtual UINT64 GetStateBytes()=0;
+  virtual void   SaveState(void *buf)=0;
+  virtual void   RestoreState(const void *buf)=0;
+
+  // Trains each branch only after `branches` younger conditional
+  // branches have been predicted, predicting them from speculative
+  // history. Returns false if the predictor cannot model the delay.
+  virtual bool SetUpdateDelay(int branches){ return branches == 0; }
+
+  UINT64 GetBudgetBits(){
+    CBP_STATE state;
+    DescribeState(&state);
+    return state.GetTotalBits();
+  }
+
+  // Predicts and updates count conditional branches in order, adding
+  // each lane's mispredictions to numMispred[lane]. The default goes
+  // through the virtual calls above; predictors override it with an
+  // inlined loop.
+  virtual void RunBatch(const CBP_TRACE_RECORD *rec, int count, UINT64 *numMispred);
+
+  // A predictor may simulate several configurations (lanes) in lock-step,
+  // each with its own misprediction count; it must then be driven
+  // through RunBatch only.
+  virtual int    NumLanes(){ return 1; }
+  virtual string GetLaneName(int lane){ return ""; }
+  virtual UINT64 GetLaneBudgetBits(int lane){ return GetBudgetBits(); }
+};
 
 /////////////////////////////////////////////////////////////
 
-void InitPredictor_openend();
-bool GetPrediction_openend(UINT32 PC);  
-void UpdatePredictor_openend(UINT32 PC, bool resolveDir, bool predDir, UINT32 branchTarget);
+// Registry of every predictor predictor.cc knows how to build,
+// looked up by the name given on the command line.
+
+typedef CBP_PREDICTOR *(*CBP_PREDICTOR_FACTORY)();
+
+struct CBP_PREDICTOR_ENTRY{
+  const char            *name;
+  const char            *desc;
+  CBP_PREDICTOR_FACTORY  create;
+};
+
+int                        NumRegisteredPredictors();
+const CBP_PREDICTOR_ENTRY *GetRegisteredPredictor(int i);
+
+// returns NULL if no predictor is registered under name
+CBP_PREDICTOR             *CreatePredictor(const char *name);
 
 /////////////////////////////////////////////////////////////
 
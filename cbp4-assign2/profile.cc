@@ -0,0 +1,98 @@
+#include <algorithm>
+#include "profile.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_BRANCH_PROFILE::CBP_BRANCH_PROFILE(int numPredictors){
+  this->numPredictors = numPredictors;
+  capacity = 1 << 12;
+  size = 0;
+
+  keys.assign(capacity, 0);
+  execs.assign(capacity, 0);
+  taken.assign(capacity, 0);
+  mispred.assign((UINT64) capacity * numPredictors, 0);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_BRANCH_PROFILE::Grow(){
+  vector<UINT64> oldKeys;
+  vector<UINT64> oldExecs, oldTaken, oldMispred;
+  UINT32 oldCapacity = capacity;
+
+  oldKeys.swap(keys);
+  oldExecs.swap(execs);
+  oldTaken.swap(taken);
+  oldMispred.swap(mispred);
+
+  capacity *= 2;
+  size = 0;
+  keys.assign(capacity, 0);
+  execs.assign(capacity, 0);
+  taken.assign(capacity, 0);
+  mispred.assign((UINT64) capacity * numPredictors, 0);
+
+  for (UINT32 i = 0; i < oldCapacity; i++) {
+    if (oldKeys[i] == 0) {
+      continue;
+    }
+    UINT32 slot = Lookup((UINT32) (oldKeys[i] - 1));
+    execs[slot] = oldExecs[i];
+    taken[slot] = oldTaken[i];
+    for (int p = 0; p < numPredictors; p++) {
+      mispred[(UINT64) slot * numPredictors + p] = oldMispred[(UINT64) i * numPredictors + p];
+    }
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_BRANCH_PROFILE::PrintReport(FILE *out, const vector<string> &names, UINT64 numInst, int topN){
+  vector<UINT32> slots;
+
+  for (UINT32 i = 0; i < capacity; i++) {
+    if (keys[i] != 0) {
+      slots.push_back(i);
+    }
+  }
+
+  fprintf(out, "\nSTATIC_COND_BRANCHES \t : %10u\n", size);
+
+  for (int p = 0; p < numPredictors; p++) {
+    UINT64 total = 0;
+    UINT64 running = 0;
+    int    n = min((int) slots.size(), topN);
+
+    for (size_t k = 0; k < slots.size(); k++) {
+      total += mispred[(UINT64) slots[k] * numPredictors + p];
+    }
+
+    partial_sort(slots.begin(), slots.begin() + n, slots.end(),
+                 [this, p](UINT32 a, UINT32 b) {
+                   return mispred[(UINT64) a * numPredictors + p] > mispred[(UINT64) b * numPredictors + p];
+                 });
+
+    fprintf(out, "\n%s: top %d branches by mispredictions\n", names[p].c_str(), n);
+    fprintf(out, "  %-10s %12s %8s %12s %8s %8s %7s\n",
+            "PC", "execs", "taken%", "mispred", "miss%", "MPKI", "cumul%");
+
+    for (int k = 0; k < n; k++) {
+      UINT32 s = slots[k];
+      UINT64 m = mispred[(UINT64) s * numPredictors + p];
+
+      running += m;
+      fprintf(out, "  0x%08x %12llu %7.2f%% %12llu %7.2f%% %8.3f %6.2f%%\n",
+              (UINT32) (keys[s] - 1), execs[s], 100.0 * taken[s] / execs[s], m,
+              100.0 * m / execs[s], 1000.0 * m / numInst,
+              total ? 100.0 * running / total : 0.0);
+    }
+  }
+  fprintf(out, "\n");
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
@@ -0,0 +1,68 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <vector>
+#include "utils.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Per-static-branch counters for every conditional branch PC: executions,
+// taken count and mispredictions per predictor. PCs live in an
+// open-addressing (linear probing) table that doubles at half load. The
+// counters sit in flat arrays beside it, so a lookup touches one key
+// line and one counter line.
+
+class CBP_BRANCH_PROFILE{
+ private:
+  int             numPredictors;
+  UINT32          capacity;       // power of two
+  UINT32          size;
+
+  vector<UINT64>  keys;           // PC + 1 (64 bits, so no PC wraps to 0), 0 = empty slot
+  vector<UINT64>  execs;
+  vector<UINT64>  taken;
+  vector<UINT64>  mispred;        // numPredictors per slot
+
+  static UINT32   Hash(UINT32 PC){ return (PC * 0x9E3779B1u) ^ (PC >> 16); }
+  void            Grow();
+
+ public:
+  CBP_BRANCH_PROFILE(int numPredictors);
+
+  // slot of PC, inserting it on first sight
+  UINT32 Lookup(UINT32 PC);
+
+  void   Record(UINT32 slot, bool resolveDir){ execs[slot]++; taken[slot] += resolveDir; }
+  void   RecordMispred(UINT32 slot, int predictor){ mispred[(UINT64) slot * numPredictors + predictor]++; }
+
+  UINT32 NumBranches(){ return size; }
+
+  // the topN branches with the most mispredictions for each predictor
+  void   PrintReport(FILE *out, const vector<string> &names, UINT64 numInst, int topN);
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+inline UINT32 CBP_BRANCH_PROFILE::Lookup(UINT32 PC){
+  UINT64 key = (UINT64) PC + 1;
+  UINT32 mask = capacity - 1;
+  UINT32 i = Hash(PC) & mask;
+
+  while (keys[i] != key) {
+    if (keys[i] == 0) {
+      if (2 * (size + 1) > capacity) {
+        Grow();
+        return Lookup(PC);
+      }
+      keys[i] = key;
+      size++;
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+#endif // _PROFILE_H_
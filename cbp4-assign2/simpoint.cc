@@ -0,0 +1,253 @@
+#include <string.h>
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+#include "slices.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// SimPoint-style slice selection. The trace is cut into fixed
+// instruction intervals. Each interval gets a basic-block vector: a
+// block ends at every control-transfer record and is weighted by its
+// instruction count, hashed on its ending PC into `dims` buckets and
+// normalised to sum 1. The vectors are clustered with k-means for
+// k = 1..maxK, and the smallest k reaching 90% of the best SSE
+// reduction is kept. The interval nearest each centroid becomes a
+// slice, weighted by its cluster's share of the intervals.
+
+#define SIMPOINT_ITERATIONS  50
+#define SIMPOINT_SSE_SHARE   0.9
+
+typedef vector<double> BBV;
+
+static bool isControl(OpType op){
+  return op >= OPTYPE_CALL_DIRECT && op <= OPTYPE_INDIRECT_BR_CALL;
+}
+
+static UINT32 hashPC(UINT32 PC, UINT32 dims){
+  return ((PC * 0x9E3779B1u) >> 8) % dims;
+}
+
+static double distance2(const BBV &a, const BBV &b){
+  double d = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    d += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return d;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+static vector<BBV> collectBBVs(char *traceFile, UINT64 interval, UINT32 dims){
+  CBP_TRACE_READER *tracer = OpenTraceReader(traceFile, false);
+  CBP_TRACE_RECORD  rec;
+  vector<BBV>       bbvs;
+  BBV               cur(dims, 0.0);
+  UINT64            blockLen = 0;
+
+  tracer->SetHeartBeat(false);
+
+  while (tracer->GetNextRecord(&rec)) {
+    blockLen++;
+    if (isControl(rec.opType)) {
+      cur[hashPC(rec.PC, dims)] += blockLen;
+      blockLen = 0;
+    }
+
+    if (tracer->GetNumInst() % interval == 0) {
+      // a block straddling the boundary is charged to the interval it ends in
+      double sum = 0;
+      for (UINT32 d = 0; d < dims; d++) {
+        sum += cur[d];
+      }
+      for (UINT32 d = 0; d < dims && sum > 0; d++) {
+        cur[d] /= sum;
+      }
+      bbvs.push_back(cur);
+      cur.assign(dims, 0.0);
+    }
+  }
+
+  delete tracer;
+  return bbvs;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// k-means with k-means++ seeding from a fixed seed; returns the SSE
+static double kmeans(const vector<BBV> &bbvs, int k, vector<BBV> *centers, vector<int> *assign){
+  UINT64 seed = 0x2545F4914F6CDD1Dull;
+  size_t n = bbvs.size();
+  vector<double> nearest(n);
+  double sse = 0;
+
+  // the (deterministic) 64-bit LCG draws uniformly from [0, 1)
+  auto rnd = [&seed]() {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return (seed >> 11) * (1.0 / 9007199254740992.0);
+  };
+
+  centers->assign(1, bbvs[0]);
+  while ((int) centers->size() < k) {
+    double total = 0;
+    for (size_t i = 0; i < n; i++) {
+      nearest[i] = distance2(bbvs[i], centers->back());
+      for (size_t c = 0; c + 1 < centers->size(); c++) {
+        nearest[i] = min(nearest[i], distance2(bbvs[i], (*centers)[c]));
+      }
+      total += nearest[i];
+    }
+    if (total == 0) {
+      break;   // fewer distinct vectors than k
+    }
+
+    double pick = rnd() * total;
+    size_t i = 0;
+    while (i + 1 < n && (pick -= nearest[i]) > 0) {
+      i++;
+    }
+    centers->push_back(bbvs[i]);
+  }
+  k = centers->size();
+
+  assign->assign(n, -1);
+  for (int it = 0; it < SIMPOINT_ITERATIONS; it++) {
+    bool moved = false;
+
+    sse = 0;
+    for (size_t i = 0; i < n; i++) {
+      int    best = 0;
+      double bestD = distance2(bbvs[i], (*centers)[0]);
+      for (int c = 1; c < k; c++) {
+        double d = distance2(bbvs[i], (*centers)[c]);
+        if (d < bestD) {
+          best = c;
+          bestD = d;
+        }
+      }
+      moved |= (*assign)[i] != best;
+      (*assign)[i] = best;
+      sse += bestD;
+    }
+    if (!moved) {
+      break;
+    }
+
+    vector<int> count(k, 0);
+    for (int c = 0; c < k; c++) {
+      (*centers)[c].assign(bbvs[0].size(), 0.0);
+    }
+    for (size_t i = 0; i < n; i++) {
+      BBV &ctr = (*centers)[(*assign)[i]];
+      for (size_t d = 0; d < ctr.size(); d++) {
+        ctr[d] += bbvs[i][d];
+      }
+      count[(*assign)[i]]++;
+    }
+    for (int c = 0; c < k; c++) {
+      for (size_t d = 0; d < (*centers)[c].size() && count[c]; d++) {
+        (*centers)[c][d] /= count[c];
+      }
+    }
+  }
+  return sse;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// usage: simpoint [-interval <inst>] [-maxk <k>] [-dims <n>] <trace> <out.slices>
+
+int main(int argc, char* argv[]){
+  UINT64 interval = 1000000;
+  int    maxK = 10;
+  UINT32 dims = 128;
+  int    arg = 1;
+
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-interval") == 0) {
+      interval = strtoull(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-maxk") == 0) {
+      maxK = atoi(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-dims") == 0) {
+      dims = atoi(argv[arg + 1]);
+    } else {
+      break;
+    }
+    arg += 2;
+  }
+
+  if (argc - arg != 2 || interval == 0 || maxK < 1 || dims == 0) {
+    printf("usage: %s [-interval <inst>] [-maxk <k>] [-dims <n>] <trace> <out.slices>\n", argv[0]);
+    exit(-1);
+  }
+
+  vector<BBV> bbvs = collectBBVs(argv[arg], interval, dims);
+
+  if (bbvs.empty()) {
+    printf("trace is shorter than one %llu-instruction interval. Dying\n", interval);
+    exit(-1);
+  }
+
+  // cluster for every k, keep the smallest one that is good enough
+  vector<vector<BBV> > centers(maxK + 1);
+  vector<vector<int> > assign(maxK + 1);
+  vector<double>       sse(maxK + 1);
+  int                  lastK = min(maxK, (int) bbvs.size());
+  int                  k;
+
+  for (k = 1; k <= lastK; k++) {
+    sse[k] = kmeans(bbvs, k, &centers[k], &assign[k]);
+  }
+  double best = sse[1];
+  for (k = 2; k <= lastK; k++) {
+    best = min(best, sse[k]);
+  }
+  for (k = 1; k < lastK; k++) {
+    if (sse[1] - sse[k] >= SIMPOINT_SSE_SHARE * (sse[1] - best)) {
+      break;
+    }
+  }
+
+  // the interval closest to each centroid represents its cluster
+  vector<CBP_SLICE> slices;
+  for (size_t c = 0; c < centers[k].size(); c++) {
+    int    rep = -1;
+    int    members = 0;
+    double repD = 0;
+
+    for (size_t i = 0; i < bbvs.size(); i++) {
+      if (assign[k][i] != (int) c) {
+        continue;
+      }
+      double d = distance2(bbvs[i], centers[k][c]);
+      if (rep < 0 || d < repD) {
+        rep = i;
+        repD = d;
+      }
+      members++;
+    }
+    if (rep >= 0) {
+      CBP_SLICE s = { rep * interval, (double) members / bbvs.size() };
+      slices.push_back(s);
+    }
+  }
+
+  FILE *out = fopen(argv[arg + 1], "w");
+  char  comment[512];
+
+  if (out == NULL) {
+    printf("Unable to create %s. Dying\n", argv[arg + 1]);
+    exit(-1);
+  }
+  snprintf(comment, sizeof(comment), "%s: %zu intervals, k=%d, sse=%.4f",
+           argv[arg], bbvs.size(), k, sse[k]);
+  WriteSlices(out, comment, interval, slices);
+  fclose(out);
+
+  printf("%zu intervals of %llu instructions, %zu slices (%.1f%% of the trace) written to %s\n",
+         bbvs.size(), interval, slices.size(), 100.0 * slices.size() / bbvs.size(), argv[arg + 1]);
+}
@@ -0,0 +1,65 @@
+#include <string.h>
+#include <algorithm>
+#include "slices.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void ReadSlices(const char *fileName, UINT64 *length, vector<CBP_SLICE> *slices){
+  FILE *in = fopen(fileName, "r");
+  char  line[256];
+
+  if (in == NULL) {
+    printf("Unable to open the slice file %s. Dying\n", fileName);
+    exit(-1);
+  }
+
+  *length = 0;
+  slices->clear();
+
+  while (fgets(line, sizeof(line), in) != NULL) {
+    CBP_SLICE s;
+
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (sscanf(line, "interval %llu", length) == 1) {
+      continue;
+    }
+    if (sscanf(line, "%llu %lf", &s.start, &s.weight) != 2 || s.weight < 0) {
+      printf("Bad line in %s: %s Dying\n", fileName, line);
+      exit(-1);
+    }
+    slices->push_back(s);
+  }
+  fclose(in);
+
+  if (*length == 0 || slices->empty()) {
+    printf("%s has no interval or no slices. Dying\n", fileName);
+    exit(-1);
+  }
+
+  sort(slices->begin(), slices->end(),
+       [](const CBP_SLICE &a, const CBP_SLICE &b) { return a.start < b.start; });
+
+  for (size_t i = 1; i < slices->size(); i++) {
+    if ((*slices)[i].start < (*slices)[i - 1].start + *length) {
+      printf("%s has overlapping slices. Dying\n", fileName);
+      exit(-1);
+    }
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void WriteSlices(FILE *out, const char *comment, UINT64 length, const vector<CBP_SLICE> &slices){
+  fprintf(out, "# %s\n", comment);
+  fprintf(out, "interval %llu\n", length);
+  for (size_t i = 0; i < slices.size(); i++) {
+    fprintf(out, "%llu %.6f\n", slices[i].start, slices[i].weight);
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
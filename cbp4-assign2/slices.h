@@ -0,0 +1,30 @@
+#ifndef _SLICES_H_
+#define _SLICES_H_
+
+#include <stdio.h>
+#include <vector>
+#include "utils.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// A representative slice of a trace: `length` instructions from record
+// `start`, standing for `weight` of the whole trace. A slice file is
+// text:
+//
+//   # comment
+//   interval <length>
+//   <start> <weight>
+//   ...
+
+struct CBP_SLICE{
+  UINT64 start;
+  double weight;
+};
+
+// reads a slice file sorted by start, dying on a malformed one
+void ReadSlices(const char *fileName, UINT64 *length, vector<CBP_SLICE> *slices);
+
+void WriteSlices(FILE *out, const char *comment, UINT64 length, const vector<CBP_SLICE> &slices);
+
+#endif // _SLICES_H_
@@ -0,0 +1,266 @@
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "sweep.h"
+#include "engine.h"
+#include "broadcast.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// strips the directory and the trace extension: /x/astar.cbp4.gz -> astar
+static string TraceName(const string &path){
+  static const char *ext[] = { ".cbp4.gz", ".gz", ".cbpx" };
+  string name = path.substr(path.find_last_of('/') + 1);
+
+  for (size_t i = 0; i < sizeof(ext) / sizeof(ext[0]); i++) {
+    size_t n = strlen(ext[i]);
+    if (name.size() > n && name.compare(name.size() - n, n, ext[i]) == 0) {
+      return name.substr(0, name.size() - n);
+    }
+  }
+  return name;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_SWEEP::CBP_SWEEP(const vector<string> &traces, const vector<string> &configs,
+                     int numThreads, bool sharedDecode, int updateDelay){
+  this->traces = traces;
+  this->configs = configs;
+  this->numThreads = numThreads > 0 ? numThreads : 1;
+  this->sharedDecode = sharedDecode && configs.size() > 1;
+  this->updateDelay = updateDelay;
+
+  // a multi-lane predictor contributes one column per lane
+  for (size_t c = 0; c < configs.size(); c++) {
+    CBP_PREDICTOR *p = CreatePredictor(configs[c].c_str());
+
+    // check before any worker thread starts
+    if (!p->SetUpdateDelay(updateDelay)) {
+      printf("%s cannot delay its update by %d branches. Dying\n", configs[c].c_str(), updateDelay);
+      exit(-1);
+    }
+
+    firstColumn.push_back(columns.size());
+    for (int l = 0; l < p->NumLanes(); l++) {
+      columns.push_back(p->NumLanes() > 1 ? configs[c] + "/" + p->GetLaneName(l) : configs[c]);
+      columnBits.push_back(p->GetLaneBudgetBits(l));
+    }
+    delete p;
+  }
+
+  results.resize(traces.size());
+  for (size_t t = 0; t < traces.size(); t++) {
+    results[t].trace = TraceName(traces[t]);
+    results[t].numInst = 0;
+    results[t].numCondBranch = 0;
+    results[t].numMispred.assign(columns.size(), 0);
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_SWEEP::RunJob(int job){
+  int t = job / configs.size();
+  int c = job % configs.size();
+
+  CBP_ENGINE engine;
+  engine.AddPredictor(configs[c].c_str());
+  engine.SetUpdateDelay(updateDelay);
+
+  CBP_TRACE_READER *tracer = OpenTraceReader((char *) traces[t].c_str(), true);
+  tracer->SetHeartBeat(false);
+
+  engine.Run(tracer);
+
+  // every job on a trace sees the same counts, the first config records them
+  if (c == 0) {
+    results[t].numInst = tracer->GetNumInst();
+    results[t].numCondBranch = tracer->GetNumCondBranch();
+  }
+  for (int k = 0; k < engine.NumPredictors(); k++) {
+    results[t].numMispred[firstColumn[c] + k] = engine.GetStats(k)->numMispred;
+  }
+
+  delete tracer;
+}
+
+// one decode of trace t fanned out to every configuration
+void CBP_SWEEP::RunShared(int t){
+  int numConsumers = min((int) configs.size(), numThreads);
+  CBP_TRACE_BROADCAST broadcast(numConsumers);
+  vector<thread> consumers;
+
+  for (int g = 0; g < numConsumers; g++) {
+    consumers.push_back(thread([this, &broadcast, numConsumers, g, t]() {
+      CBP_ENGINE engine;
+      const CBP_TRACE_BATCH *b;
+      size_t c;
+
+      // consumer g owns configurations g, g+numConsumers, ...
+      for (c = g; c < configs.size(); c += numConsumers) {
+        engine.AddPredictor(configs[c].c_str());
+      }
+      engine.SetUpdateDelay(updateDelay);
+
+      for (UINT64 seq = 0; (b = broadcast.Acquire(g, seq)) != NULL; seq++) {
+        engine.ProcessBatch(b->rec, b->count);
+        broadcast.Release(g);
+      }
+
+      // engine rows follow the configs in order, lane by lane
+      int k = 0;
+      for (c = g; c < configs.size(); c += numConsumers) {
+        int lanes = engine.GetStats(k)->numLanes;
+        for (int l = 0; l < lanes; l++) {
+          results[t].numMispred[firstColumn[c] + l] = engine.GetStats(k++)->numMispred;
+        }
+      }
+    }));
+  }
+
+  CBP_TRACE_READER *tracer = OpenTraceReader((char *) traces[t].c_str(), true);
+  tracer->SetHeartBeat(false);
+  broadcast.Produce(tracer);
+  delete tracer;
+
+  for (size_t g = 0; g < consumers.size(); g++) {
+    consumers[g].join();
+  }
+
+  results[t].numInst = broadcast.GetNumInst();
+  results[t].numCondBranch = broadcast.GetNumCondBranch();
+}
+
+void CBP_SWEEP::Run(){
+  if (sharedDecode) {
+    for (size_t t = 0; t < traces.size(); t++) {
+      RunShared(t);
+    }
+    return;
+  }
+
+  int numJobs = traces.size() * configs.size();
+  atomic<int> nextJob(0);
+  vector<thread> workers;
+
+  for (int w = 0; w < numThreads && w < numJobs; w++) {
+    workers.push_back(thread([this, &nextJob, numJobs]() {
+      int job;
+      while ((job = nextJob++) < numJobs) {
+        RunJob(job);
+      }
+    }));
+  }
+
+  for (size_t w = 0; w < workers.size(); w++) {
+    workers[w].join();
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+double CBP_SWEEP::GetMPKI(int trace, int column){
+  const CBP_SWEEP_RESULT &r = results[trace];
+  return 1000.0*(double)(r.numMispred[column])/(double)(r.numInst);
+}
+
+// a zero MPKI anywhere makes the geometric mean zero
+void CBP_SWEEP::Means(int column, double *amean, double *gmean){
+  double sum = 0, logSum = 0;
+  bool   zero = false;
+
+  for (size_t t = 0; t < traces.size(); t++) {
+    double mpki = GetMPKI(t, column);
+    sum += mpki;
+    if (mpki > 0) {
+      logSum += log(mpki);
+    } else {
+      zero = true;
+    }
+  }
+
+  *amean = sum / traces.size();
+  *gmean = zero ? 0.0 : exp(logSum / traces.size());
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_SWEEP::WriteCSV(FILE *out){
+  size_t c, t;
+
+  fprintf(out, "trace,instructions,conditional_branches");
+  for (c = 0; c < columns.size(); c++) {
+    fprintf(out, ",%s", columns[c].c_str());
+  }
+  fprintf(out, "\n");
+
+  for (t = 0; t < traces.size(); t++) {
+    fprintf(out, "%s,%llu,%llu", results[t].trace.c_str(),
+            results[t].numInst, results[t].numCondBranch);
+    for (c = 0; c < columns.size(); c++) {
+      fprintf(out, ",%.3f", GetMPKI(t, c));
+    }
+    fprintf(out, "\n");
+  }
+
+  for (int g = 0; g < 2; g++) {
+    fprintf(out, g ? "GMEAN,," : "AMEAN,,");
+    for (c = 0; c < columns.size(); c++) {
+      double amean, gmean;
+      Means(c, &amean, &gmean);
+      fprintf(out, ",%.3f", g ? gmean : amean);
+    }
+    fprintf(out, "\n");
+  }
+
+  fprintf(out, "STORAGE_BITS,,");
+  for (c = 0; c < columns.size(); c++) {
+    fprintf(out, ",%llu", BudgetBits(c));
+  }
+  fprintf(out, "\n");
+}
+
+void CBP_SWEEP::WriteJSON(FILE *out){
+  size_t c, t;
+
+  fprintf(out, "{\n  \"configs\": [");
+  for (c = 0; c < columns.size(); c++) {
+    fprintf(out, "%s\"%s\"", c ? ", " : "", columns[c].c_str());
+  }
+  fprintf(out, "],\n  \"storage_bits\": [");
+  for (c = 0; c < columns.size(); c++) {
+    fprintf(out, "%s%llu", c ? ", " : "", BudgetBits(c));
+  }
+  fprintf(out, "],\n  \"traces\": [\n");
+
+  for (t = 0; t < traces.size(); t++) {
+    fprintf(out, "    { \"trace\": \"%s\", \"instructions\": %llu, \"conditional_branches\": %llu,\n      \"mpki\": [",
+            results[t].trace.c_str(), results[t].numInst, results[t].numCondBranch);
+    for (c = 0; c < columns.size(); c++) {
+      fprintf(out, "%s%.3f", c ? ", " : "", GetMPKI(t, c));
+    }
+    fprintf(out, "] }%s\n", t + 1 < traces.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n");
+
+  for (int g = 0; g < 2; g++) {
+    fprintf(out, g ? "  \"gmean\": [" : "  \"amean\": [");
+    for (c = 0; c < columns.size(); c++) {
+      double amean, gmean;
+      Means(c, &amean, &gmean);
+      fprintf(out, "%s%.3f", c ? ", " : "", g ? gmean : amean);
+    }
+    fprintf(out, g ? "]\n" : "],\n");
+  }
+  fprintf(out, "}\n");
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
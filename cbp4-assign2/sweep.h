@@ -0,0 +1,64 @@
+#ifndef _SWEEP_H_
+#define _SWEEP_H_
+
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+#include "predictor.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Results of every predictor configuration on one trace.
+
+struct CBP_SWEEP_RESULT{
+  string         trace;          // basename without .cbp4.gz / .cbpx
+  UINT64         numInst;
+  UINT64         numCondBranch;
+  vector<UINT64> numMispred;     // one per column
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Runs every (trace, configuration) pair across a pool of worker threads.
+//
+// With shared decode (the default when there is more than one
+// configuration), traces are taken one at a time. The calling thread
+// decodes each trace once and broadcasts record batches to numThreads
+// consumers. Each consumer owns the predictors of its share of the
+// configurations. Without shared decode, each (trace, configuration)
+// job owns its own tracer and predictor instance.
+
+class CBP_SWEEP{
+ private:
+  vector<string>           traces;
+  vector<string>           configs;
+  vector<string>           columns;       // configs, multi-lane ones split per lane
+  vector<int>              firstColumn;   // per config
+  vector<UINT64>           columnBits;
+  int                      numThreads;
+  bool                     sharedDecode;
+  int                      updateDelay;   // branches, see CBP_PREDICTOR::SetUpdateDelay
+  vector<CBP_SWEEP_RESULT> results;
+
+ public:
+  CBP_SWEEP(const vector<string> &traces, const vector<string> &configs,
+            int numThreads, bool sharedDecode=true, int updateDelay=0);
+
+  void   Run();
+
+  double GetMPKI(int trace, int column);
+  UINT64 BudgetBits(int column){ return columnBits[column]; }
+
+  // one row per trace plus AMEAN, GMEAN and STORAGE_BITS rows
+  void   WriteCSV(FILE *out);
+  void   WriteJSON(FILE *out);
+
+ private:
+  void   RunJob(int job);
+  void   RunShared(int trace);
+  void   Means(int column, double *amean, double *gmean);
+};
+
+#endif // _SWEEP_H_
@@ -0,0 +1,170 @@
+#include "target.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_BTB::CBP_BTB(UINT32 entries, UINT32 ways)
+  : tag(entries, 0), target(entries, 0), lastUse(entries, 0){
+
+  this->ways = ways;
+  numSets = entries / ways;
+  now = 0;
+
+  numLookups = 0;
+  numMisses = 0;
+  numWrongTarget = 0;
+}
+
+void CBP_BTB::Access(UINT32 PC, UINT32 branchTarget){
+  UINT32 set = (PC ^ (PC >> 12)) % numSets;
+  UINT32 base = set * ways;
+  UINT32 victim = base;
+
+  numLookups++;
+  now++;
+
+  for (UINT32 i = base; i < base + ways; i++) {
+    if (tag[i] == PC + 1) {
+      if (target[i] != branchTarget) {
+        numWrongTarget++;
+        target[i] = branchTarget;
+      }
+      lastUse[i] = now;
+      return;
+    }
+    if (lastUse[i] < lastUse[victim]) {
+      victim = i;
+    }
+  }
+
+  numMisses++;
+  tag[victim] = PC + 1;
+  target[victim] = branchTarget;
+  lastUse[victim] = now;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_RAS::CBP_RAS(UINT32 depth)
+  : stack(depth, 0){
+
+  top = 0;
+  pos = 0;
+
+  numCalls = 0;
+  numReturns = 0;
+  numMispred = 0;
+  numOverflows = 0;
+}
+
+void CBP_RAS::Push(UINT32 callPC){
+  numCalls++;
+
+  if (top == stack.size()) {
+    numOverflows++;
+  } else {
+    top++;
+  }
+  stack[pos] = callPC;
+  pos = (pos + 1) % stack.size();
+}
+
+void CBP_RAS::Pop(UINT32 returnTarget){
+  numReturns++;
+
+  if (top == 0) {
+    numMispred++;
+    return;
+  }
+  top--;
+  pos = (pos + stack.size() - 1) % stack.size();
+
+  UINT32 callPC = stack[pos];
+  if (returnTarget <= callPC || returnTarget - callPC > CBP_MAX_INST_BYTES) {
+    numMispred++;
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_INDIRECT_PREDICTOR::CBP_INDIRECT_PREDICTOR(UINT32 logEntries)
+  : tag(1u << logEntries, 0), target(1u << logEntries, 0){
+
+  this->logEntries = logEntries;
+  pathHist = 0;
+
+  numLookups = 0;
+  numMispred = 0;
+}
+
+void CBP_INDIRECT_PREDICTOR::Access(UINT32 PC, UINT32 branchTarget){
+  UINT32 idx = (PC ^ (PC >> logEntries) ^ pathHist) & ((1u << logEntries) - 1);
+
+  numLookups++;
+
+  if (tag[idx] != PC + 1 || target[idx] != branchTarget) {
+    numMispred++;
+    tag[idx] = PC + 1;
+    target[idx] = branchTarget;
+  }
+
+  // two low-order target bits (past the alignment bits) per indirect
+  pathHist = ((pathHist << 2) ^ (branchTarget >> 2)) & ((1u << CBP_ITP_PATH_BITS) - 1);
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_TARGET_MODEL::CBP_TARGET_MODEL()
+  : btb(CBP_BTB_ENTRIES, CBP_BTB_WAYS), ras(CBP_RAS_DEPTH), itp(CBP_ITP_LOG_ENTRIES){
+}
+
+void CBP_TARGET_MODEL::Process(const CBP_TRACE_RECORD *rec){
+  switch (rec->opType) {
+  case OPTYPE_BRANCH_COND:
+    if (rec->branchTaken) {
+      btb.Access(rec->PC, rec->branchTarget);
+    }
+    break;
+  case OPTYPE_BRANCH_UNCOND:
+    btb.Access(rec->PC, rec->branchTarget);
+    break;
+  case OPTYPE_CALL_DIRECT:
+    btb.Access(rec->PC, rec->branchTarget);
+    ras.Push(rec->PC);
+    break;
+  case OPTYPE_INDIRECT_BR_CALL:
+    itp.Access(rec->PC, rec->branchTarget);
+    ras.Push(rec->PC);
+    break;
+  case OPTYPE_RET:
+    ras.Pop(rec->branchTarget);
+    break;
+  default:
+    break;
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+void CBP_TARGET_MODEL::PrintStats(UINT64 numInst){
+  printf("\nBTB:     LOOKUPS              \t : %10llu", btb.numLookups);
+  printf("\nBTB:     MISSES               \t : %10llu", btb.numMisses);
+  printf("\nBTB:     WRONG_TARGET         \t : %10llu", btb.numWrongTarget);
+  printf("\nBTB:     MISPRED_PER_1K_INST  \t : %10.3f", 1000.0*(double)(btb.numMisses + btb.numWrongTarget)/(double)(numInst));
+  printf("\nRAS:     CALLS                \t : %10llu", ras.numCalls);
+  printf("\nRAS:     RETURNS              \t : %10llu", ras.numReturns);
+  printf("\nRAS:     OVERFLOWS            \t : %10llu", ras.numOverflows);
+  printf("\nRAS:     NUM_MISPREDICTIONS   \t : %10llu", ras.numMispred);
+  printf("\nRAS:     MISPRED_PER_1K_INST  \t : %10.3f", 1000.0*(double)(ras.numMispred)/(double)(numInst));
+  printf("\nITP:     LOOKUPS              \t : %10llu", itp.numLookups);
+  printf("\nITP:     NUM_MISPREDICTIONS   \t : %10llu", itp.numMispred);
+  printf("\nITP:     MISPRED_PER_1K_INST  \t : %10.3f", 1000.0*(double)(itp.numMispred)/(double)(numInst));
+  printf("\n\n");
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
@@ -0,0 +1,113 @@
+#ifndef _TARGET_H_
+#define _TARGET_H_
+
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+#define CBP_BTB_ENTRIES      4096
+#define CBP_BTB_WAYS         4
+#define CBP_RAS_DEPTH        32
+#define CBP_ITP_LOG_ENTRIES  10
+#define CBP_ITP_PATH_BITS    12     // target bits of path history
+
+// The traces carry no instruction lengths, so the return address of a
+// call is unknown. A return counts as correctly predicted when it lands
+// within one maximum-length (x86) instruction after the popped call.
+#define CBP_MAX_INST_BYTES   15
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Set-associative, LRU branch target buffer for direct control
+// transfers. Only taken transfers look it up; a miss or a stale target
+// is a target misprediction and (re)writes the entry.
+
+class CBP_BTB{
+ private:
+  UINT32         numSets;
+  UINT32         ways;
+  vector<UINT32> tag;              // PC + 1, 0 = invalid
+  vector<UINT32> target;
+  vector<UINT64> lastUse;
+  UINT64         now;
+
+ public:
+  UINT64         numLookups;
+  UINT64         numMisses;
+  UINT64         numWrongTarget;
+
+  CBP_BTB(UINT32 entries, UINT32 ways);
+  void Access(UINT32 PC, UINT32 branchTarget);
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Circular return address stack: a push on a full stack overwrites the
+// oldest entry, a pop on an empty one mispredicts.
+
+class CBP_RAS{
+ private:
+  vector<UINT32> stack;
+  UINT32         top;              // entries pushed, saturating at depth
+  UINT32         pos;              // slot of the next push
+
+ public:
+  UINT64         numCalls;
+  UINT64         numReturns;
+  UINT64         numMispred;
+  UINT64         numOverflows;
+
+  CBP_RAS(UINT32 depth);
+  void Push(UINT32 callPC);
+  void Pop(UINT32 returnTarget);
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Tagged target cache for indirect branches (Chang, Hao and Patt),
+// indexed by the PC hashed with a history of recent indirect targets.
+
+class CBP_INDIRECT_PREDICTOR{
+ private:
+  UINT32         logEntries;
+  vector<UINT32> tag;
+  vector<UINT32> target;
+  UINT32         pathHist;
+
+ public:
+  UINT64         numLookups;
+  UINT64         numMispred;
+
+  CBP_INDIRECT_PREDICTOR(UINT32 logEntries);
+  void Access(UINT32 PC, UINT32 branchTarget);
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Front-end target prediction for every control transfer of a trace:
+// direct jumps and calls (and taken conditional branches) go to the BTB,
+// returns to the RAS, indirect branches to the target cache. Indirect
+// records are pushed on the RAS as calls, since the trace does not tell
+// indirect calls from indirect jumps.
+
+class CBP_TARGET_MODEL{
+ private:
+  CBP_BTB                btb;
+  CBP_RAS                ras;
+  CBP_INDIRECT_PREDICTOR itp;
+
+ public:
+  CBP_TARGET_MODEL();
+
+  void Process(const CBP_TRACE_RECORD *rec);
+  void PrintStats(UINT64 numInst);
+};
+
+#endif // _TARGET_H_
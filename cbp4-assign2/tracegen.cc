@@ -0,0 +1,249 @@
+#include <string.h>
+#include <vector>
+#include "utils.h"
+#include "tracer.h"
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Synthetic CBP4 traces from a pattern spec, one pattern per line of a
+// spec file or per ';'-separated item on the command line. Patterns run
+// one after the other, each in its own 16MB PC region:
+//
+//   periodic <T/N pattern> <reps>   one branch repeating e.g. TTTTTTN
+//   loop <trip>[x<trip>...]         nested do-while loops, outermost
+//                                   first: loop 100000x7 is mb.c case I
+//   correlated <count>              two random branches, then one taken
+//                                   iff exactly one of them was (XOR)
+//   random <bias> <count>           one branch taken with probability bias
+//   alias <branches> <count>        branches 64KB apart (equal low PC
+//                                   bits), alternately always taken and
+//                                   never taken, run round-robin
+//
+// Every branch is preceded by -ops non-branch instructions (default 3).
+
+#define TRACEGEN_REGION      0x01000000
+#define TRACEGEN_BASE        0x00400000
+#define TRACEGEN_ALIAS_STEP  0x00010000
+
+// Branch `slot` of a pattern. The low PC bits are staggered like those
+// of real code, so that distinct branches do not share PHT sets or
+// bimodal counters unless a pattern asks for it.
+static UINT32 branchPC(UINT32 base, int slot){
+  return base + 0x100 * (slot + 1) + 3 * slot;
+}
+
+class TRACE_GENERATOR{
+ private:
+  CBP_TRACE_WRITER *out;
+  UINT32            ops;
+  UINT64            rng;
+
+ public:
+  UINT64            numInst;
+  UINT64            numCondBranch;
+
+  TRACE_GENERATOR(char *fileName, UINT32 ops, UINT64 seed){
+    out = new CBP_TRACE_WRITER(fileName);
+    this->ops = ops;
+    rng = seed ? seed : 1;
+    numInst = 0;
+    numCondBranch = 0;
+  }
+  ~TRACE_GENERATOR(){ delete out; }
+
+  // xorshift64*, uniform in [0, 1)
+  double Uniform(){
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return ((rng * 2685821657736338717ull) >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // the filler instructions sit just before the branch, which jumps
+  // back to the first of them when taken
+  void Branch(UINT32 PC, bool taken){
+    CBP_TRACE_RECORD rec;
+    UINT32 head = PC - 4 * ops;
+
+    for (UINT32 j = 0; j < ops; j++) {
+      rec.PC = head + 4 * j;
+      rec.opType = OPTYPE_OP;
+      rec.branchTaken = false;
+      rec.branchTarget = 0;
+      out->Write(&rec);
+    }
+
+    rec.PC = PC;
+    rec.opType = OPTYPE_BRANCH_COND;
+    rec.branchTaken = taken;
+    rec.branchTarget = head;
+    out->Write(&rec);
+
+    numInst += ops + 1;
+    numCondBranch++;
+  }
+
+  void Loop(const vector<UINT64> &trips, size_t level, UINT32 base){
+    UINT32 PC = branchPC(base, level);
+
+    for (UINT64 i = 1; i <= trips[level]; i++) {
+      if (level + 1 < trips.size()) {
+        Loop(trips, level + 1, base);
+      }
+      Branch(PC, i < trips[level]);
+    }
+  }
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+static void badSpec(const char *spec){
+  printf("bad pattern '%s'. Dying\n", spec);
+  exit(-1);
+}
+
+static void generate(TRACE_GENERATOR *gen, const char *spec, UINT32 base){
+  char   kind[32], arg[256];
+  UINT64 count;
+  double bias;
+  int    n;
+
+  if (sscanf(spec, "%31s", kind) != 1) {
+    return;
+  }
+  UINT32 PC = branchPC(base, 0);
+
+  if (strcmp(kind, "periodic") == 0) {
+    if (sscanf(spec, "%*s %255s %llu", arg, &count) != 2) {
+      badSpec(spec);
+    }
+    for (UINT64 r = 0; r < count; r++) {
+      for (const char *c = arg; *c; c++) {
+        if (*c != 'T' && *c != 'N') {
+          badSpec(spec);
+        }
+        gen->Branch(PC, *c == 'T');
+      }
+    }
+  } else if (strcmp(kind, "loop") == 0) {
+    vector<UINT64> trips;
+    char *p = arg;
+
+    if (sscanf(spec, "%*s %255s", arg) != 1) {
+      badSpec(spec);
+    }
+    while (*p) {
+      UINT64 t = strtoull(p, &p, 10);
+      if (t == 0 || (*p != 'x' && *p != '\0')) {
+        badSpec(spec);
+      }
+      trips.push_back(t);
+      p += (*p == 'x');
+    }
+    gen->Loop(trips, 0, base);
+  } else if (strcmp(kind, "correlated") == 0) {
+    if (sscanf(spec, "%*s %llu", &count) != 1) {
+      badSpec(spec);
+    }
+    for (UINT64 r = 0; r < count; r++) {
+      bool a = gen->Uniform() < 0.5;
+      bool b = gen->Uniform() < 0.5;
+      gen->Branch(PC, a);
+      gen->Branch(branchPC(base, 1), b);
+      gen->Branch(branchPC(base, 2), a != b);
+    }
+  } else if (strcmp(kind, "random") == 0) {
+    if (sscanf(spec, "%*s %lf %llu", &bias, &count) != 2 || bias < 0 || bias > 1) {
+      badSpec(spec);
+    }
+    for (UINT64 r = 0; r < count; r++) {
+      gen->Branch(PC, gen->Uniform() < bias);
+    }
+  } else if (strcmp(kind, "alias") == 0) {
+    if (sscanf(spec, "%*s %d %llu", &n, &count) != 2 || n < 1 ||
+        (UINT64) n * TRACEGEN_ALIAS_STEP > TRACEGEN_REGION - 0x100) {
+      badSpec(spec);
+    }
+    for (UINT64 r = 0; r < count; r++) {
+      for (int k = 0; k < n; k++) {
+        gen->Branch(PC + k * TRACEGEN_ALIAS_STEP, (k & 1) == 0);
+      }
+    }
+  } else {
+    badSpec(spec);
+  }
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// usage: tracegen [-ops <n>] [-seed <n>] (-f <specfile> | <pattern>[;<pattern>...]) <out.gz>
+
+int main(int argc, char* argv[]){
+  UINT32         ops = 3;
+  UINT64         seed = 1;
+  const char    *specFile = NULL;
+  vector<string> specs;
+  int            arg = 1;
+
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-ops") == 0) {
+      ops = atoi(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-seed") == 0) {
+      seed = strtoull(argv[arg + 1], NULL, 0);
+    } else if (strcmp(argv[arg], "-f") == 0) {
+      specFile = argv[arg + 1];
+    } else {
+      break;
+    }
+    arg += 2;
+  }
+
+  if (argc - arg != (specFile ? 1 : 2)) {
+    printf("usage: %s [-ops <n>] [-seed <n>] (-f <specfile> | <pattern>[;<pattern>...]) <out.gz>\n", argv[0]);
+    exit(-1);
+  }
+
+  if (specFile != NULL) {
+    FILE *in = fopen(specFile, "r");
+    char  line[512];
+
+    if (in == NULL) {
+      printf("Unable to open %s. Dying\n", specFile);
+      exit(-1);
+    }
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (line[0] != '#') {
+        specs.push_back(line);
+      }
+    }
+    fclose(in);
+  } else {
+    string all = argv[arg++];
+    size_t pos = 0, semi;
+
+    do {
+      semi = all.find(';', pos);
+      specs.push_back(all.substr(pos, semi == string::npos ? string::npos : semi - pos));
+      pos = semi + 1;
+    } while (semi != string::npos);
+  }
+
+  TRACE_GENERATOR *gen = new TRACE_GENERATOR(argv[arg], ops, seed);
+  UINT32           base = TRACEGEN_BASE;
+
+  for (size_t i = 0; i < specs.size(); i++) {
+    UINT64 before = gen->numCondBranch;
+
+    generate(gen, specs[i].c_str(), base);
+    if (gen->numCondBranch != before) {
+      base += TRACEGEN_REGION;
+    }
+  }
+
+  printf("wrote %llu instructions, %llu conditional branches to %s\n",
+         gen->numInst, gen->numCondBranch, argv[arg]);
+  delete gen;
+}
@@ -12,46 +12,85 @@
 // IMPORTANT NOTE: Changing anything in here will violate the competition rules.
 
 #include <assert.h>
+#include <string.h>
 #include "tracer.h"
+#include "cbpx.h"
 
 /////////////////////////////////////////
 /////////////////////////////////////////
 
-CBP_TRACER::CBP_TRACER(char *traceFileName){
-  char  cmdString[1024];
-  
-  sprintf(cmdString,"gunzip -c %s", traceFileName);
+CBP_TRACER::CBP_TRACER(char *traceFileName, bool condOnly){
 
-  if ((traceFile = popen(cmdString, "r")) == NULL){
+  // gzopen reads gzip and uncompressed traces alike
+  if ((traceFile = gzopen(traceFileName, "rb")) == NULL){
    printf("Unable to open the trace file. Dying\n");
    exit(-1);
   }
+  gzbuffer(traceFile, CBP_BLOCK_BYTES);
 
-  numInst=0;
-  numCondBranch=0;
+  block = new unsigned char[CBP_BLOCK_BYTES];
+  blockLen=0;
+  blockPos=0;
 
+  this->condOnly=condOnly;
+}
+
+CBP_TRACER::~CBP_TRACER(){
+  gzclose(traceFile);
+  delete [] block;
 }
 
 /////////////////////////////////////////
 /////////////////////////////////////////
 
-bool  CBP_TRACER::GetNextRecord(CBP_TRACE_RECORD *rec){
+// Slides any partial record to the front of the block and decodes
+// the next chunk behind it. Returns FAILURE once no full record is left.
+
+bool  CBP_TRACER::FillBlock(){
+  UINT32 left = blockLen - blockPos;
 
-  fread (&rec->PC, 4, 1, traceFile);
-  fread (&rec->branchTarget, 4, 1, traceFile);
-  fread (&rec->opType, 1, 1, traceFile);
-  fread (&rec->branchTaken, 1, 1, traceFile);
+  memmove(block, block + blockPos, left);
+  blockLen = left;
+  blockPos = 0;
 
-  if(feof(traceFile)){
-    return FAILURE; 
+  while (blockLen < CBP_BLOCK_BYTES) {
+    int got = gzread(traceFile, block + blockLen, CBP_BLOCK_BYTES - blockLen);
+
+    if (got <= 0) {
+      break;
+    }
+    blockLen += got;
   }
 
-  // sanity check
-  assert(rec->opType < OPTYPE_MAX);
+  return (blockLen >= CBP_RECORD_BYTES) ? SUCCESS : FAILURE;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+bool  CBP_TRACER::GetNextRecord(CBP_TRACE_RECORD *rec){
+
+  do {
+    if(blockLen - blockPos < CBP_RECORD_BYTES && !FillBlock()){
+      return FAILURE; 
+    }
+
+    const unsigned char *r = block + blockPos;
+    blockPos += CBP_RECORD_BYTES;
 
-  // update trace stats and heartbeat
-  numInst++;
-  CheckHeartBeat();
+    memcpy(&rec->PC, r, 4);
+    memcpy(&rec->branchTarget, r + 4, 4);
+    rec->opType = (OpType) r[8];
+    rec->branchTaken = r[9];
+
+    // sanity check
+    assert(rec->opType < OPTYPE_MAX);
+
+    // update trace stats and heartbeat
+    numInst++;
+    CheckHeartBeat();
+
+  } while(condOnly && rec->opType != OPTYPE_BRANCH_COND);
 
   if(rec->opType == OPTYPE_BRANCH_COND){
     numCondBranch++;
@@ -60,13 +99,99 @@ bool  CBP_TRACER::GetNextRecord(CBP_TRACE_RECORD *rec){
   return SUCCESS; 
 }
 
+// only the opType byte of a skipped record is looked at
+
+void  CBP_TRACER::SkipTo(UINT64 inst){
+  while (numInst < inst) {
+    if(blockLen - blockPos < CBP_RECORD_BYTES && !FillBlock()){
+      return;
+    }
+
+    if(block[blockPos + 8] == OPTYPE_BRANCH_COND){
+      numCondBranch++;
+    }
+    blockPos += CBP_RECORD_BYTES;
+    numInst++;
+  }
+  lastHeartBeat = numInst;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_TRACE_WRITER::CBP_TRACE_WRITER(char *traceFileName){
+
+  if ((traceFile = gzopen(traceFileName, "wb")) == NULL){
+   printf("Unable to create the trace file. Dying\n");
+   exit(-1);
+  }
+
+  block = new unsigned char[CBP_BLOCK_BYTES];
+  blockLen=0;
+}
+
+CBP_TRACE_WRITER::~CBP_TRACE_WRITER(){
+  Flush();
+  if (gzclose(traceFile) != Z_OK){
+   printf("Unable to finish the trace file. Dying\n");
+   exit(-1);
+  }
+  delete [] block;
+}
+
+void  CBP_TRACE_WRITER::Flush(){
+  if (blockLen > 0 && gzwrite(traceFile, block, blockLen) != (int) blockLen){
+   printf("Unable to write the trace file. Dying\n");
+   exit(-1);
+  }
+  blockLen=0;
+}
+
+void  CBP_TRACE_WRITER::Write(const CBP_TRACE_RECORD *rec){
+  unsigned char *r;
+
+  if (CBP_BLOCK_BYTES - blockLen < CBP_RECORD_BYTES) {
+    Flush();
+  }
+  r = block + blockLen;
+  blockLen += CBP_RECORD_BYTES;
+
+  memcpy(r, &rec->PC, 4);
+  memcpy(r + 4, &rec->branchTarget, 4);
+  r[8] = rec->opType;
+  r[9] = rec->branchTaken;
+}
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+CBP_TRACE_READER *OpenTraceReader(char *traceFileName, bool condOnly){
+  char  magic[CBPX_MAGIC_BYTES];
+  FILE *f = fopen(traceFileName, "rb");
+
+  if (f != NULL && fread(magic, CBPX_MAGIC_BYTES, 1, f) == 1 &&
+      memcmp(magic, CBPX_MAGIC, CBPX_MAGIC_BYTES) == 0) {
+    fclose(f);
+    return new CBPX_TRACER(traceFileName, condOnly);
+  }
+  if (f != NULL) {
+    fclose(f);
+  }
+
+  return new CBP_TRACER(traceFileName, condOnly);
+}
+
 /////////////////////////////////////////
 /////////////////////////////////////////
 
-void CBP_TRACER::CheckHeartBeat(){
+void CBP_TRACE_READER::CheckHeartBeat(){
   UINT64 dotInterval=1000000;
   UINT64 lineInterval=30*dotInterval;
 
+  if(!heartBeat){
+    return;
+  }
+
   if(numInst-lastHeartBeat >= dotInterval){
     printf("."); 
     fflush(stdout);
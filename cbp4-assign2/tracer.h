@@ -1,11 +1,21 @@
 #ifndef _TRACER_H_
 #define _TRACER_H_
 
+#include <zlib.h>
 #include "utils.h"
 
 /////////////////////////////////////////
 /////////////////////////////////////////
 
+// on-disk record: PC(4) branchTarget(4) opType(1) branchTaken(1)
+#define CBP_RECORD_BYTES   10
+
+// decompressed bytes handed out per gzread
+#define CBP_BLOCK_BYTES    (1<<20)
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
 
 typedef enum {
   OPTYPE_LOAD             =0, 
@@ -41,26 +51,98 @@ class CBP_TRACE_RECORD{
 /////////////////////////////////////////
 /////////////////////////////////////////
 
-class CBP_TRACER{
- private:
-  FILE *traceFile;
+// Common front for every trace format. Keeps the instruction and
+// conditional branch counts that the stats block divides by.
 
+class CBP_TRACE_READER{
+ protected:
   UINT64 numInst;        
   UINT64 numCondBranch;
 
   UINT64 lastHeartBeat;
+  bool   heartBeat;
 
  public:
-  CBP_TRACER(char *traceFileName);
+  CBP_TRACE_READER(){
+    numInst=0;
+    numCondBranch=0;
+    lastHeartBeat=0;
+    heartBeat=true;
+  }
+  virtual ~CBP_TRACE_READER(){}
+
+  virtual bool GetNextRecord(CBP_TRACE_RECORD *record)=0;
+
+  // moves forward so that the next record read is record number inst
+  // (counting from 0), updating the counts as if every skipped record
+  // had been read. Never moves backward.
+  virtual void SkipTo(UINT64 inst)=0;
 
-  bool   GetNextRecord(CBP_TRACE_RECORD *record);  
   UINT64 GetNumInst(){ return numInst; }
   UINT64 GetNumCondBranch(){ return numCondBranch; }
 
- private:
+  // progress dots on stdout, on by default
+  void   SetHeartBeat(bool on){ heartBeat=on; }
+
+ protected:
   void   CheckHeartBeat();
 };
 
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// CBP4 gzip (or raw) trace of 10-byte records. With condOnly set,
+// non-branch records are counted but never handed out.
+
+class CBP_TRACER : public CBP_TRACE_READER{
+ private:
+  gzFile traceFile;
+  bool   condOnly;
+
+  unsigned char *block;  // reusable decode buffer
+  UINT32 blockLen;       // valid bytes in block
+  UINT32 blockPos;       // next unread byte in block
+
+ public:
+  CBP_TRACER(char *traceFileName, bool condOnly=false);
+  ~CBP_TRACER();
+
+  bool   GetNextRecord(CBP_TRACE_RECORD *record);  
+  void   SkipTo(UINT64 inst);
+
+ private:
+  bool   FillBlock();
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Writes records in the CBP4 gzip format CBP_TRACER reads back.
+
+class CBP_TRACE_WRITER{
+ private:
+  gzFile traceFile;
+
+  unsigned char *block;  // records not yet handed to gzwrite
+  UINT32 blockLen;
+
+ public:
+  CBP_TRACE_WRITER(char *traceFileName);
+  ~CBP_TRACE_WRITER();
+
+  void   Write(const CBP_TRACE_RECORD *record);
+
+ private:
+  void   Flush();
+};
+
+/////////////////////////////////////////
+/////////////////////////////////////////
+
+// Picks the reader from the file magic: .cbpx files are mapped,
+// anything else goes through CBP_TRACER.
+
+CBP_TRACE_READER *OpenTraceReader(char *traceFileName, bool condOnly);
 
 /////////////////////////////////////////
 /////////////////////////////////////////
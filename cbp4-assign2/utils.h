@@ -21,6 +21,7 @@
 
 using namespace std;
 
+#define UINT8       unsigned char
 #define UINT32      unsigned int
 #define INT32       int
 #define UINT64      unsigned long long
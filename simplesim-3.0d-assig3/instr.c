@@ -8,17 +8,23 @@
 
 #include "instr.h"
 
+/* ECE552 BEGIN */
 //prints a single instruction
-static void print_tom_instr(instruction_t* instr) {
+void fprint_tom_instr(FILE *stream, instruction_t* instr) {
 
-  md_print_insn(instr->inst, instr->pc, stdout);
-  myfprintf(stdout, "\t%d\t%d\t%d\t%d\n", 
+  md_print_insn(instr->inst, instr->pc, stream);
+  myfprintf(stream, "\t%d\t%d\t%d\t%d\n", 
 	    instr->tom_dispatch_cycle,
 	    instr->tom_issue_cycle,
 	    instr->tom_execute_cycle,
 	    instr->tom_cdb_cycle);
 }
 
+static void print_tom_instr(instruction_t* instr) {
+  fprint_tom_instr(stdout, instr);
+}
+/* ECE552 END */
+
 
 //prints all the instructions inside the given trace for pipeline
 void print_all_instr(instruction_trace_t* trace, int sim_num_insn) {
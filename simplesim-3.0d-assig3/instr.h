@@ -2,6 +2,7 @@
 #ifndef INSTR_H
 #define INSTR_H
 
+#include <stdio.h>
 #include "machine.h"
 
 //data structure representing each instruction
@@ -25,6 +26,14 @@ typedef struct my_instruction
   int tom_execute_cycle;   //execute
   int tom_cdb_cycle;       //writeback via Common Data Bus (CDB)
 
+  /* ECE552 BEGIN */
+  int tom_complete;        //set once the instruction has left the timing model
+  int tom_done_cycle;      //cycle its result was ready to commit, 0 until then (ROB only)
+
+  md_addr_t npc;           //pc of the instruction executed next
+  md_addr_t target_pc;     //branch target if taken
+  /* ECE552 END */
+
 }instruction_t;
 
 #define INSTR_TRACE_SIZE 16384
@@ -39,6 +48,11 @@ typedef struct my_instruction_list
 //prints all the instructions inside the given trace
 extern void print_all_instr(instruction_trace_t* table, int sim_num_insn);
 
+/* ECE552 BEGIN */
+//prints the timing table row of one instruction to stream
+extern void fprint_tom_instr(FILE *stream, instruction_t* instr);
+/* ECE552 END */
+
 //inserts the instruction into the trace
 extern void put_instr(instruction_trace_t* trace, instruction_t* instr);
 
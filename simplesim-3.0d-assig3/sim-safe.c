@@ -66,6 +66,9 @@
 #include "sim.h"
 
 #include "instr.h"
+/* ECE552 BEGIN */
+#include "tomasulo.h"
+/* ECE552 END */
 #include "decode.def"
 #include <assert.h>
 
@@ -88,6 +91,22 @@ static counter_t sim_num_refs = 0;
 
 /* ECE552 BEGIN */
 static counter_t sim_num_tom_cycles = 0;
+
+/* Tomasulo branch predictor configuration, as in sim-bpred */
+static char *tom_pred_type;
+static int tom_bimod_nelt = 1;
+static int tom_bimod_config[1] =
+  { /* bimod tbl size */2048 };
+static int tom_twolev_nelt = 4;
+static int tom_twolev_config[4] =
+  { /* l1size */1, /* l2size */1024, /* hist */8, /* xor */FALSE};
+static int tom_comb_nelt = 1;
+static int tom_comb_config[1] =
+  { /* meta_table_size */1024 };
+static int tom_ras_size = 8;
+static int tom_btb_nelt = 2;
+static int tom_btb_config[2] =
+  { /* nsets */512, /* assoc */4 };
 /* ECE552 END */
 
 /* maximum number of inst's to execute */
@@ -110,13 +129,185 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &max_insts, /* default */0,
 	       /* print */TRUE, /* format */NULL);
 
+  /* ECE552 BEGIN */
+  /* Tomasulo structure sizes and latencies */
+  opt_reg_int(odb, "-tom:ifqsize", "instruction fetch queue size (in insts)",
+	      &tom_ifq_size, /* default */tom_ifq_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:rs_int", "number of integer reservation stations",
+	      &tom_rs_int_size, /* default */tom_rs_int_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:rs_fp", "number of floating point reservation stations",
+	      &tom_rs_fp_size, /* default */tom_rs_fp_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:fu_int", "number of integer functional units",
+	      &tom_fu_int_size, /* default */tom_fu_int_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:fu_fp", "number of floating point functional units",
+	      &tom_fu_fp_size, /* default */tom_fu_fp_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:lat_int", "integer execute latency (in cycles)",
+	      &tom_fu_int_latency, /* default */tom_fu_int_latency,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:lat_fp", "floating point execute latency (in cycles)",
+	      &tom_fu_fp_latency, /* default */tom_fu_fp_latency,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:width", "instructions fetched and dispatched per cycle",
+	      &tom_dispatch_width, /* default */tom_dispatch_width,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:cdbs", "number of common data buses",
+	      &tom_num_cdbs, /* default */tom_num_cdbs,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:rob", "reorder buffer entries (0 for no ROB)",
+	      &tom_rob_size, /* default */tom_rob_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:commit", "instructions committed per cycle (with a ROB)",
+	      &tom_commit_width, /* default */tom_commit_width,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:sb", "store buffer entries (with a ROB)",
+	      &tom_sb_size, /* default */tom_sb_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_string(odb, "-tom:bpred",
+		 "branch predictor type {perfect|nottaken|taken|bimod|2lev|comb}",
+		 &tom_pred_type, /* default */"perfect",
+		 /* print */TRUE, /* format */NULL);
+  opt_reg_int_list(odb, "-tom:bpred:bimod",
+		   "bimodal predictor config (<table size>)",
+		   tom_bimod_config, tom_bimod_nelt, &tom_bimod_nelt,
+		   /* default */tom_bimod_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int_list(odb, "-tom:bpred:2lev",
+		   "2-level predictor config "
+		   "(<l1size> <l2size> <hist_size> <xor>)",
+		   tom_twolev_config, tom_twolev_nelt, &tom_twolev_nelt,
+		   /* default */tom_twolev_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int_list(odb, "-tom:bpred:comb",
+		   "combining predictor config (<meta_table_size>)",
+		   tom_comb_config, tom_comb_nelt, &tom_comb_nelt,
+		   /* default */tom_comb_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int(odb, "-tom:bpred:ras",
+	      "return address stack size (0 for no return stack)",
+	      &tom_ras_size, /* default */tom_ras_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int_list(odb, "-tom:bpred:btb",
+		   "BTB config (<num_sets> <associativity>)",
+		   tom_btb_config, tom_btb_nelt, &tom_btb_nelt,
+		   /* default */tom_btb_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_int(odb, "-tom:bpred:penalty",
+	      "cycles to refetch after a mispredicted branch resolves",
+	      &tom_mispred_penalty, /* default */tom_mispred_penalty,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-tom:window", "initial instructions buffered ahead of the timing model (grows as needed)",
+	      &tom_window_size, /* default */tom_window_size,
+	      /* print */TRUE, /* format */NULL);
+  opt_reg_string(odb, "-tom:table", "per-instruction timing table output file",
+		 &tom_table_file, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+  /* ECE552 END */
 }
 
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-  /* nada */
+  /* ECE552 BEGIN */
+  if (tom_ifq_size < 1)
+    fatal("instruction fetch queue must have at least one entry");
+  if (tom_rs_int_size < 1 || tom_rs_fp_size < 1)
+    fatal("need at least one integer and one floating point reservation station");
+  if (tom_fu_int_size < 1 || tom_fu_fp_size < 1)
+    fatal("need at least one integer and one floating point functional unit");
+  if (tom_fu_int_latency < 1 || tom_fu_fp_latency < 1)
+    fatal("execute latencies must be at least one cycle");
+  if (tom_dispatch_width < 1 || tom_num_cdbs < 1)
+    fatal("dispatch width and number of CDBs must be at least one");
+  if (tom_rob_size < 0)
+    fatal("ROB size cannot be negative");
+  if (tom_commit_width < 1 || tom_sb_size < 1)
+    fatal("commit width and store buffer size must be at least one");
+  if (tom_mispred_penalty < 0)
+    fatal("mispredict penalty cannot be negative");
+
+  if (!mystricmp(tom_pred_type, "perfect"))
+    {
+      /* no predictor, control instructions never stall fetch */
+      tom_bpred = NULL;
+    }
+  else if (!mystricmp(tom_pred_type, "taken"))
+    {
+      tom_bpred = bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+  else if (!mystricmp(tom_pred_type, "nottaken"))
+    {
+      tom_bpred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+  else if (!mystricmp(tom_pred_type, "bimod"))
+    {
+      if (tom_bimod_nelt != 1)
+	fatal("bad bimod predictor config (<table_size>)");
+      if (tom_btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      tom_bpred = bpred_create(BPred2bit,
+			       /* bimod table size */tom_bimod_config[0],
+			       /* 2lev l1 size */0,
+			       /* 2lev l2 size */0,
+			       /* meta table size */0,
+			       /* history reg size */0,
+			       /* history xor address */0,
+			       /* btb sets */tom_btb_config[0],
+			       /* btb assoc */tom_btb_config[1],
+			       /* ret-addr stack size */tom_ras_size);
+    }
+  else if (!mystricmp(tom_pred_type, "2lev"))
+    {
+      if (tom_twolev_nelt != 4)
+	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
+      if (tom_btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      tom_bpred = bpred_create(BPred2Level,
+			       /* bimod table size */0,
+			       /* 2lev l1 size */tom_twolev_config[0],
+			       /* 2lev l2 size */tom_twolev_config[1],
+			       /* meta table size */0,
+			       /* history reg size */tom_twolev_config[2],
+			       /* history xor address */tom_twolev_config[3],
+			       /* btb sets */tom_btb_config[0],
+			       /* btb assoc */tom_btb_config[1],
+			       /* ret-addr stack size */tom_ras_size);
+    }
+  else if (!mystricmp(tom_pred_type, "comb"))
+    {
+      if (tom_twolev_nelt != 4)
+	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
+      if (tom_bimod_nelt != 1)
+	fatal("bad bimod predictor config (<table_size>)");
+      if (tom_comb_nelt != 1)
+	fatal("bad combining predictor config (<meta_table_size>)");
+      if (tom_btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      tom_bpred = bpred_create(BPredComb,
+			       /* bimod table size */tom_bimod_config[0],
+			       /* l1 size */tom_twolev_config[0],
+			       /* l2 size */tom_twolev_config[1],
+			       /* meta table size */tom_comb_config[0],
+			       /* history reg size */tom_twolev_config[2],
+			       /* history xor address */tom_twolev_config[3],
+			       /* btb sets */tom_btb_config[0],
+			       /* btb assoc */tom_btb_config[1],
+			       /* ret-addr stack size */tom_ras_size);
+    }
+  else
+    fatal("cannot parse predictor type `%s'", tom_pred_type);
+
+  if (tom_window_size < 1)
+    fatal("Tomasulo window must start with at least one entry");
+  /* ECE552 END */
 }
 
 /* register simulator-specific statistics */
@@ -141,6 +332,53 @@ sim_reg_stats(struct stat_sdb_t *sdb)
   stat_reg_counter(sdb, "sim_num_tom_cycles",
 		   "total number of cycles with tomasulo",
 		   &sim_num_tom_cycles, 0, NULL);
+  stat_reg_formula(sdb, "sim_tom_CPI",
+		   "cycles per instruction with tomasulo",
+		   "sim_num_tom_cycles / sim_num_insn", NULL);
+  stat_reg_counter(sdb, "sim_tom_rob_full",
+		   "cycles ending with a full ROB and an instruction waiting to dispatch",
+		   &tom_rob_full_cycles, 0, NULL);
+  stat_reg_counter(sdb, "sim_tom_sb_full",
+		   "cycles commit stalled on a full store buffer",
+		   &tom_sb_full_cycles, 0, NULL);
+  stat_reg_counter(sdb, "sim_tom_mispred_cycles",
+		   "mispredict penalty cycles in which fetch had room and work",
+		   &tom_mispred_cycles, 0, NULL);
+
+  /* the configuration the cycle count belongs to, so sweeps over the
+     -tom:* options can be collected from the stats alone */
+  stat_reg_int(sdb, "tom_ifqsize", "instruction fetch queue size",
+	       &tom_ifq_size, tom_ifq_size, NULL);
+  stat_reg_int(sdb, "tom_rs_int", "integer reservation stations",
+	       &tom_rs_int_size, tom_rs_int_size, NULL);
+  stat_reg_int(sdb, "tom_rs_fp", "floating point reservation stations",
+	       &tom_rs_fp_size, tom_rs_fp_size, NULL);
+  stat_reg_int(sdb, "tom_fu_int", "integer functional units",
+	       &tom_fu_int_size, tom_fu_int_size, NULL);
+  stat_reg_int(sdb, "tom_fu_fp", "floating point functional units",
+	       &tom_fu_fp_size, tom_fu_fp_size, NULL);
+  stat_reg_int(sdb, "tom_lat_int", "integer execute latency",
+	       &tom_fu_int_latency, tom_fu_int_latency, NULL);
+  stat_reg_int(sdb, "tom_lat_fp", "floating point execute latency",
+	       &tom_fu_fp_latency, tom_fu_fp_latency, NULL);
+  stat_reg_int(sdb, "tom_width", "dispatch width",
+	       &tom_dispatch_width, tom_dispatch_width, NULL);
+  stat_reg_int(sdb, "tom_cdbs", "common data buses",
+	       &tom_num_cdbs, tom_num_cdbs, NULL);
+  stat_reg_int(sdb, "tom_rob", "reorder buffer entries",
+	       &tom_rob_size, tom_rob_size, NULL);
+  stat_reg_int(sdb, "tom_commit", "commit width",
+	       &tom_commit_width, tom_commit_width, NULL);
+  stat_reg_int(sdb, "tom_sb", "store buffer entries",
+	       &tom_sb_size, tom_sb_size, NULL);
+  stat_reg_int(sdb, "tom_bpred_penalty", "mispredict refetch penalty",
+	       &tom_mispred_penalty, tom_mispred_penalty, NULL);
+  stat_reg_int(sdb, "tom_window", "final size of the Tomasulo window (doubled as needed)",
+	       &tom_window_size, tom_window_size, NULL);
+
+  /* mispredict stats of the Tomasulo branch predictor */
+  if (tom_bpred)
+    bpred_reg_stats(tom_bpred, sdb);
   /* ECE552 END */
 
   ld_reg_stats(sdb);
@@ -208,6 +446,12 @@ sim_uninit(void)
 /* next program counter */
 #define SET_NPC(EXPR)		(regs.regs_NPC = (EXPR))
 
+/* ECE552 BEGIN */
+/* target program counter, for the Tomasulo branch predictor */
+#undef  SET_TPC
+#define SET_TPC(EXPR)		(m_instr.target_pc = (EXPR))
+/* ECE552 END */
+
 /* current program counter */
 #define CPC			(regs.regs_PC)
 
@@ -288,10 +532,6 @@ sim_uninit(void)
 /* system call handler macro */
 #define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
 
-/* ECE552 BEGIN */
-instruction_trace_t* instruction_trace;
-/* ECE552 END */
-
 /* start simulation, program loaded, processor precise state initialized */
 void
 sim_main(void)
@@ -306,11 +546,7 @@ sim_main(void)
   instruction_t m_instr;
   memset(&m_instr, 0, sizeof(instruction_t));
 
-  instruction_trace = malloc(sizeof(instruction_trace_t));
-  assert(instruction_trace != NULL);
-  memset(instruction_trace, 0, sizeof(instruction_trace_t));
-  //skip the first entry
-  instruction_trace->size++;
+  startTomasulo();
   /* ECE552 END */
 
   fprintf(stderr, "sim: ** starting functional simulation **\n");
@@ -374,7 +610,8 @@ sim_main(void)
       }
 
       /* ECE552 BEGIN */
-      put_instr(instruction_trace, &m_instr);
+      m_instr.npc = regs.regs_NPC;
+      pushTomasulo(&m_instr);
       /* ECE552 END */
 
       if (fault != md_fault_none)
@@ -416,10 +653,6 @@ sim_main(void)
 
     /* ECE552 BEGIN */
 
-    sim_num_tom_cycles = runTomasulo(instruction_trace);
-  
-    //print_all_instr(instruction_trace, sim_num_insn);
-
-    free(instruction_trace);
+    sim_num_tom_cycles = finishTomasulo();
     /* ECE552 END */
 }
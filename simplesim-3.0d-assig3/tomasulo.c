@@ -20,18 +20,36 @@
 #include "decode.def"
 
 #include "instr.h"
+#include "tomasulo.h"
 
-/* PARAMETERS OF THE TOMASULO'S ALGORITHM */
+/* PARAMETERS OF THE TOMASULO'S ALGORITHM (defaults, see tomasulo.h) */
 
-#define INSTR_QUEUE_SIZE         16
+int tom_ifq_size       = 16;
 
-#define RESERV_INT_SIZE    5
-#define RESERV_FP_SIZE     3
-#define FU_INT_SIZE        3
-#define FU_FP_SIZE         1
+int tom_rs_int_size    = 5;
+int tom_rs_fp_size     = 3;
+int tom_fu_int_size    = 3;
+int tom_fu_fp_size     = 1;
 
-#define FU_INT_LATENCY     5
-#define FU_FP_LATENCY      7
+int tom_fu_int_latency = 5;
+int tom_fu_fp_latency  = 7;
+
+int tom_dispatch_width = 1;
+int tom_num_cdbs       = 1;
+
+int tom_rob_size       = 0;   //no ROB
+int tom_commit_width   = 1;
+int tom_sb_size        = 8;
+
+struct bpred_t* tom_bpred = NULL;
+int tom_mispred_penalty = 3;
+
+int   tom_window_size  = 16384;
+char* tom_table_file   = NULL;
+
+counter_t tom_rob_full_cycles = 0;
+counter_t tom_sb_full_cycles  = 0;
+counter_t tom_mispred_cycles  = 0;
 
 /* IDENTIFYING INSTRUCTIONS */
 
@@ -77,8 +95,8 @@
 
 /* VARIABLES */
 
-//instruction queue for tomasulo
-static instruction_t* instr_queue[INSTR_QUEUE_SIZE];
+//instruction queue for tomasulo (tom_ifq_size entries)
+static instruction_t** instr_queue;
 //number of instructions in the instruction queue
 static int instr_queue_size = 0;
 
@@ -93,25 +111,111 @@ static int insn_complete = 0;
 /* ECE552 Assignment 3 - END CODE */
 
 //reservation stations (each reservation station entry contains a pointer to an instruction)
-static instruction_t* reservINT[RESERV_INT_SIZE];
-static instruction_t* reservFP[RESERV_FP_SIZE];
+static instruction_t** reservINT;
+static instruction_t** reservFP;
 
 //functional units
-static instruction_t* fuINT[FU_INT_SIZE];
-static instruction_t* fuFP[FU_FP_SIZE];
+static instruction_t** fuINT;
+static instruction_t** fuFP;
 
 //The map table keeps track of which instruction produces the value for each register
 static instruction_t* map_table[MD_TOTAL_REGS];
 
+/* ECE552 BEGIN */
+
+/* Event-driven wakeup and select. RS entries are numbered INT first, then FP,
+   and each FU remembers the entry of its instruction. Every entry keeps a
+   bitmask of the source operands still waiting for a broadcast, and each
+   waiting operand (entry * 3 + slot) is linked into its producer entry's
+   list of dependents, so a broadcast only touches those. An entry whose mask
+   empties joins its class's ready list, kept oldest first. */
+
+#define CLASS_INT 0
+#define CLASS_FP  1
+
+static int  map_entry[MD_TOTAL_REGS];  //RS entry of map_table[reg]
+
+static int* rs_wait_mask;     //per entry: operands not yet broadcast
+static int* rs_ready_cycle;   //per entry: cycle the last operand arrived (0: at dispatch)
+static int* dep_head;         //per producer entry: first dependent operand, -1 if none
+static int* dep_next;         //per operand: next dependent of the same producer
+static int* ready_next;       //per entry: next younger ready entry, -1 at the tail
+static int  ready_head[2];    //per class: oldest ready entry, -1 if none
+
+static int* free_entries[2];  //per class: stack of free entries
+static int  num_free[2];
+
+static int* fuINT_entry;      //RS entry of the instruction in each FU
+static int* fuFP_entry;
+
+/* Optional reorder buffer (tom_rob_size > 0). Every dispatched instruction
+   takes an entry, a broadcast (or the end of a store's execute, or a branch's
+   dispatch) only marks it done, and up to tom_commit_width done instructions
+   leave from the head each cycle, the cycle after they were done at the
+   earliest. Committed stores go through a store buffer that writes one store
+   back to memory per cycle; commit stalls while it is full. */
+
+static instruction_t** rob;
+static int rob_head;
+static int rob_count;
+static int sb_count;          //committed stores not yet written to memory
+
+/* Branch prediction (tom_bpred != NULL). Control instructions look up and
+   train the predictor as they are fetched. The trace only holds the correct
+   path, so a mispredict is modelled as fetch stopping behind the branch until
+   it resolves at dispatch, then refetching for tom_mispred_penalty cycles. */
+
+static instruction_t* mispred_branch;  //unresolved mispredicted branch, NULL if none
+static int fetch_resume_cycle;         //first cycle fetch may run again
+
+/* ECE552 END */
+
 //the index of the last instruction fetched
 static int fetch_index = 1;
 
+/* ECE552 BEGIN */
+
+/* The functional simulator pushes instructions into a ring of tom_window_size
+   slots and the timing model runs behind it, a cycle at a time, as soon as
+   every instruction that cycle could fetch has been pushed. Instructions leave
+   the window in order once complete, which is when their table row is final.
+   Nothing bounds how far completed instructions can run ahead of an
+   incomplete older one (branches and traps hold no RS entry), so the window
+   doubles whenever the timing model cannot free the slot it needs. */
+
+static instruction_t* window;
+static int num_pushed;         //index of the last instruction pushed
+static bool pushing_done;      //the functional simulation has ended
+static int retire_index;       //oldest instruction still in the window
+static int cycle;
+static FILE* table_stream;     //NULL unless -tom:table
+
+static instruction_t* window_instr(int index) {
+    return &window[index % tom_window_size];
+}
+
+static void complete(instruction_t *insn) {
+    insn->tom_complete = 1;
+    insn_complete++;
+}
+
+// the instruction has its result, it completes now or, with a ROB, once it commits
+static void finish(instruction_t *insn, int current_cycle) {
+    if (tom_rob_size > 0) {
+        insn->tom_done_cycle = current_cycle;
+    } else {
+        complete(insn);
+    }
+}
+
+/* ECE552 END */
+
 
 /* ECE552 Assignment 3 - BEGIN CODE */
 
-static bool is_simulation_done(counter_t sim_insn) {
+static bool is_simulation_done(void) {
     // simulation is done when the # of completed instructions equals the # of instructions in the trace
-    if (insn_complete == sim_insn) {
+    if (pushing_done && insn_complete == num_pushed) {
         return true;
     } else {
         return false;
@@ -119,179 +223,176 @@ static bool is_simulation_done(counter_t sim_insn) {
 }
 
 
-void execute_To_CDB(int current_cycle) {
-    int i, j; 
-    int oldestD = INT_MAX;
-    int intOldestDIdx = -1;
-    int floatOldestDIdx = -1;
-    instruction_t *executing_insn, *rs_insn;
-
-    // find the oldest instruction that has completed from the integer FUs
-    for (i = 0; i < FU_INT_SIZE; i++) {
-        executing_insn = fuINT[i];
+static int first_entry(int cls) {
+    return cls == CLASS_INT ? 0 : tom_rs_int_size;
+}
 
-        // check if instruction has completed
-        if (executing_insn != NULL && executing_insn->tom_execute_cycle + 5 <= current_cycle) {
-            
-            // completed store instructions don't compete for the cdb
-            if (IS_STORE(executing_insn->op)) {
-                // mark instruction as complete
-                executing_insn->tom_cdb_cycle = 0;
-                insn_complete++;
-                // free function unit
-                fuINT[i] = NULL;
-                
-                // free reservation station entry
-                for(j = 0; j < RESERV_INT_SIZE; j++) {
-                    rs_insn = reservINT[j];
-                    
-                    if (rs_insn == executing_insn) {
-                        reservINT[j] = NULL;
-                        break;
-                    }
-                }
-            }
+static instruction_t** reserv_of(int cls) {
+    return cls == CLASS_INT ? reservINT : reservFP;
+}
 
-            // update oldest instruction if this instruction is older
-            else if (executing_insn->tom_dispatch_cycle < oldestD) {
-                oldestD = executing_insn->tom_dispatch_cycle;
-                intOldestDIdx = i;
-            }
+static int class_of(int entry) {
+    return entry < tom_rs_int_size ? CLASS_INT : CLASS_FP;
+}
+
+static instruction_t* rs_insn(int entry) {
+    int cls = class_of(entry);
+    return reserv_of(cls)[entry - first_entry(cls)];
+}
+
+// links a ready entry into its class's ready list, keeping it oldest first
+static void make_ready(int entry, int current_cycle) {
+    int cls = class_of(entry);
+    int index = rs_insn(entry)->index;
+    int *link = &ready_head[cls];
+
+    rs_ready_cycle[entry] = current_cycle;
+    while (*link != -1 && rs_insn(*link)->index < index) {
+        link = &ready_next[*link];
+    }
+    ready_next[entry] = *link;
+    *link = entry;
+}
+
+// frees the RS entry of an instruction leaving its FU
+static void free_entry(int entry) {
+    int cls = class_of(entry);
+
+    reserv_of(cls)[entry - first_entry(cls)] = NULL;
+    free_entries[cls][num_free[cls]++] = entry;
+}
+
+
+// broadcasts a completed instruction on a CDB, wakes its dependents and frees its FU and RS entry
+static void write_CDB(instruction_t **fu, int *fu_entry, int current_cycle) {
+    instruction_t *insn = *fu;
+    int entry = *fu_entry;
+    int i, node, consumer;
+
+    insn->tom_cdb_cycle = current_cycle;
+
+    // instruction will be completed by the end of this cycle
+    finish(insn, current_cycle);
+
+    // update map table
+    for (i = 0; i < 2; i++) {
+
+        // if tag matches, clear it
+        if (insn->r_out[i] != -1 && map_table[insn->r_out[i]] == insn) {
+            map_table[insn->r_out[i]] = NULL;
         }
     }
 
-    // now going through the FP FUs to see if any instructions are complete and are older than all integer instructions
-    for (j = 0; j < FU_FP_SIZE; j++) {
-        executing_insn = fuFP[j];
-        
-        if (executing_insn != NULL && executing_insn->tom_execute_cycle + 7 <= current_cycle) {
-            
-            if (executing_insn->tom_dispatch_cycle < oldestD) {
-                oldestD = executing_insn->tom_dispatch_cycle;
-                floatOldestDIdx = j;
-            }
+    // wake up only the operands waiting on this tag
+    for (node = dep_head[entry]; node != -1; node = dep_next[node]) {
+        consumer = node / 3;
+        rs_wait_mask[consumer] &= ~(1 << (node % 3));
+
+        if (rs_wait_mask[consumer] == 0) {
+            make_ready(consumer, current_cycle);
         }
     }
 
-    // if FP instruction is oldest
-    if (floatOldestDIdx != -1) {
-        executing_insn = fuFP[floatOldestDIdx];
-        executing_insn->tom_cdb_cycle = current_cycle;
-        
-        // instruction will be completed by the end of this cycle
-        insn_complete++;
-
-        // update map table
-        for (j = 0; j < 2; j++) {
-            
-            // if tag matches, clear it
-            if (executing_insn->r_out[j] != -1 && map_table[executing_insn->r_out[j]] == executing_insn) {
-                map_table[executing_insn->r_out[j]] = NULL;
-            }
+    // free functional unit and reservation station entry
+    *fu = NULL;
+    free_entry(entry);
+}
+
+
+void execute_To_CDB(int current_cycle) {
+    int i, bus;
+    int oldest;
+    int intOldestIdx, floatOldestIdx;
+    instruction_t *executing_insn;
+
+    // completed store instructions don't compete for the cdb
+    for (i = 0; i < tom_fu_int_size; i++) {
+        executing_insn = fuINT[i];
+
+        if (executing_insn != NULL && IS_STORE(executing_insn->op) &&
+            executing_insn->tom_execute_cycle + tom_fu_int_latency <= current_cycle) {
+            // mark instruction as complete
+            executing_insn->tom_cdb_cycle = 0;
+            finish(executing_insn, current_cycle);
+            // free function unit and reservation station entry
+            fuINT[i] = NULL;
+            free_entry(fuINT_entry[i]);
         }
+    }
 
-        // free functional unit
-        fuFP[floatOldestDIdx] = NULL;
-        
-        // free reservation station entry
-        for(i = 0; i < RESERV_FP_SIZE; i++) {
-            rs_insn = reservFP[i];
-            
-            if (rs_insn == executing_insn) {
-                reservFP[i] = NULL;
-                break;
+    // each CDB goes to the oldest (in program order) completed instruction left, INT or FP
+    for (bus = 0; bus < tom_num_cdbs; bus++) {
+        oldest = INT_MAX;
+        intOldestIdx = -1;
+        floatOldestIdx = -1;
+
+        for (i = 0; i < tom_fu_int_size; i++) {
+            executing_insn = fuINT[i];
+
+            if (executing_insn != NULL && executing_insn->tom_execute_cycle + tom_fu_int_latency <= current_cycle &&
+                executing_insn->index < oldest) {
+                oldest = executing_insn->index;
+                intOldestIdx = i;
             }
         }
-    
-    // if integer instruction is oldest, do the same thing but free the integer structures
-    } else if (intOldestDIdx != -1) {
-        executing_insn = fuINT[intOldestDIdx];
-        executing_insn->tom_cdb_cycle = current_cycle;
-        
-        insn_complete++;
-
-        for (j = 0; j < 2; j++) {
-            
-            if (executing_insn->r_out[j] != -1 && map_table[executing_insn->r_out[j]] == executing_insn) {
-                map_table[executing_insn->r_out[j]] = NULL;
+
+        for (i = 0; i < tom_fu_fp_size; i++) {
+            executing_insn = fuFP[i];
+
+            if (executing_insn != NULL && executing_insn->tom_execute_cycle + tom_fu_fp_latency <= current_cycle &&
+                executing_insn->index < oldest) {
+                oldest = executing_insn->index;
+                floatOldestIdx = i;
             }
         }
 
-        fuINT[intOldestDIdx] = NULL;
+        // if FP instruction is oldest
+        if (floatOldestIdx != -1) {
+            write_CDB(&fuFP[floatOldestIdx], &fuFP_entry[floatOldestIdx], current_cycle);
 
-        for(i = 0; i < RESERV_INT_SIZE; i++) {
-            rs_insn = reservINT[i];
-            
-            if (rs_insn == executing_insn) {
-                reservINT[i] = NULL;
-                break;
-            }
+        // if integer instruction is oldest
+        } else if (intOldestIdx != -1) {
+            write_CDB(&fuINT[intOldestIdx], &fuINT_entry[intOldestIdx], current_cycle);
+
+        // nothing left to broadcast
+        } else {
+            break;
         }
     }
 }
 
 
-void issue_To_execute(int current_cycle) {
-    int i, j, k, oldestD_JustReady, oldestDIdx_JustReady, oldestD_Older, oldestDIdx_Older;
-    bool insnReady, justReady;
-    instruction_t *insn, *dependency;
-    
-    // for every single empty integer FU, try to allocate it to a valid instruction (can allocate multiple in one cycle)
-    for (i = 0; i < FU_INT_SIZE; i++) {
-        
-        if (fuINT[i] == NULL) {
-            // oldest instruction that just became availible, if no instructions were waiting because of structural hazards these will go
-            oldestD_JustReady = INT_MAX;
-            oldestDIdx_JustReady = -1;
-            
-            // oldest instructions that were ready last cycle, but were only held back by a structural hazard 
-            // they have priority and have effectively been issued last cycle as the respective FU was being freed
-            oldestD_Older = INT_MAX;
-            oldestDIdx_Older = -1;
-
-            for (j = 0; j < RESERV_INT_SIZE; j++) {
-                insn = reservINT[j];
-                
-                // check if the RS entry has an instruction which hasn't executed yet
-                if (insn != NULL && insn->tom_execute_cycle == '\0') {
-                    insnReady = true;
-                    justReady = false;
-
-                    // check if all dependencies are availible for this instruction
-                    for(k = 0; k < 3; k++) {
-                        dependency = insn->Q[k];
-                        
-                        // dependency is availible as long as dependent instruction has already been broadcasted to cdb
-                        if (dependency != NULL) {
-
-                            if (dependency->tom_cdb_cycle == '\0') {
-                                insnReady = false;
-                                break;
-                            }
-
-                            // this is to check if the instruction just got ready this cycle
-                            if (dependency->tom_cdb_cycle == current_cycle) {
-                                justReady = true;
-                            }
-                        }
-                    }
-                    
-                    // update a ready isntruction, that just got ready, if it is older than previous oldest 
-                    if (insnReady && justReady && insn->tom_dispatch_cycle < oldestD_JustReady) {
-                        oldestD_JustReady = insn->tom_dispatch_cycle;
-                        oldestDIdx_JustReady = j;
-
-                    // update a ready instruction, that is now ready because of resolution of structural hazard, if it is older than oldest
-                    } else if (insnReady && !justReady && insn->tom_dispatch_cycle < oldestD_Older) {
-                        oldestD_Older = insn->tom_dispatch_cycle;
-                        oldestDIdx_Older = j;
-                    }
-                }
+// Fills the free FUs of one class from its ready list. Instructions that were
+// ready last cycle, but were only held back by a structural hazard, have
+// priority and have effectively been issued last cycle as the respective FU
+// was being freed; those that just got ready this cycle go after them.
+static void issue_class(int cls, instruction_t **fu, int *fu_entry, int fu_size, int current_cycle) {
+    int i = 0, pass, entry, next;
+    int *link;
+    instruction_t *insn;
+
+    for (pass = 0; pass < 2; pass++) {
+        link = &ready_head[cls];
+
+        for (entry = *link; entry != -1; entry = next) {
+            next = ready_next[entry];
+
+            // pass 0 takes the older ones, pass 1 the ones that just got ready
+            if ((rs_ready_cycle[entry] == current_cycle) != (pass == 1)) {
+                link = &ready_next[entry];
+                continue;
+            }
+
+            // find a free FU, if there are none left we are done
+            while (i < fu_size && fu[i] != NULL) {
+                i++;
             }
-            
-            // if there was an instruction that was ready in the previous cycle, allocate its oldest, and set its execute start to this cycle
-            if (oldestDIdx_Older != -1) {
-                insn = reservINT[oldestDIdx_Older];
+            if (i == fu_size) {
+                return;
+            }
+
+            insn = rs_insn(entry);
+            if (pass == 0) {
                 insn->tom_execute_cycle = current_cycle;
 
                 // black magic to make the intermediate cycles counts not break any obvious rules (ie. not staring multiple stages in the same cycle)
@@ -299,241 +400,341 @@ void issue_To_execute(int current_cycle) {
                 // I had to alter my design last minute because of new information and this is the most elegent way I can make it work
                 if (insn->tom_execute_cycle == insn->tom_issue_cycle) {
                     insn->tom_issue_cycle--;
-                
+
                     if (insn->tom_issue_cycle == insn->tom_dispatch_cycle) {
                         insn->tom_issue_cycle++;
                         insn->tom_execute_cycle++;
                     }
                 }
-
-                fuINT[i] = insn;
-
-            // if there was no instruction in the previous cycle, allocate an instruction that just got ready, and set its X start to this cycle
-            } else if (oldestDIdx_JustReady != -1) {
-                insn = reservINT[oldestDIdx_JustReady];
-                insn->tom_execute_cycle = current_cycle + 1;
-                fuINT[i] = insn;
-
-            // if no valid integer instructions exit loop, no more FUs have a chance of being allocated
             } else {
-                break;
+                insn->tom_execute_cycle = current_cycle + 1;
             }
+
+            fu[i] = insn;
+            fu_entry[i] = entry;
+
+            // unlink it from the ready list
+            *link = next;
         }
     }
-    
-    // same thing but for floating point FUs
-    for (i = 0; i < FU_FP_SIZE; i++) {
-        
-        if (fuFP[i] == NULL) {
-            oldestD_JustReady = INT_MAX;
-            oldestDIdx_JustReady = -1;
-
-            oldestD_Older = INT_MAX;
-            oldestDIdx_Older = -1;
-            
-            for (j = 0; j < RESERV_FP_SIZE; j++) {
-                insn = reservFP[j];
-                
-                if (insn != NULL && insn->tom_execute_cycle == '\0') {
-                    insnReady = true;
-                    justReady = false;
-                    
-                    for(k = 0; k < 3; k++) {
-                        dependency = insn->Q[k];
-                        
-                        if (dependency != NULL) {
-
-                            if (dependency->tom_cdb_cycle == '\0') {
-                                insnReady = false;
-                                break;
-                            }
-                            if (dependency->tom_cdb_cycle == current_cycle) {
-                                justReady = true;
-                            }
-                        }
-                    }
-                    
-                    if (insnReady && justReady && insn->tom_dispatch_cycle < oldestD_JustReady) {
-                        oldestD_JustReady = insn->tom_dispatch_cycle;
-                        oldestDIdx_JustReady = j;
-
-                    } else if (insnReady && !justReady && insn->tom_dispatch_cycle < oldestD_Older) {
-                        oldestD_Older = insn->tom_dispatch_cycle;
-                        oldestDIdx_Older = j;
-                    }
-                }
-            }
-            
-            if (oldestDIdx_Older != -1) {
-                insn = reservFP[oldestDIdx_Older];
-                insn->tom_execute_cycle = current_cycle;
+}
 
-                if (insn->tom_execute_cycle == insn->tom_issue_cycle) {
-                    insn->tom_issue_cycle--;
-                
-                    if (insn->tom_issue_cycle == insn->tom_dispatch_cycle) {
-                        insn->tom_issue_cycle++;
-                        insn->tom_execute_cycle++;
-                    }
-                }
 
-                fuFP[i] = insn;
+void issue_To_execute(int current_cycle) {
+    issue_class(CLASS_INT, fuINT, fuINT_entry, tom_fu_int_size, current_cycle);
+    issue_class(CLASS_FP, fuFP, fuFP_entry, tom_fu_fp_size, current_cycle);
+}
 
-            } else if (oldestDIdx_JustReady != -1) {
-                insn = reservFP[oldestDIdx_JustReady];
-                insn->tom_execute_cycle = current_cycle + 1;
-                fuFP[i] = insn;
 
-            } else {
-                break;
+// places insn in a free entry of its class's reservation stations, returns false if they are full
+static bool dispatch_To_RS(instruction_t *insn, int cls, int current_cycle) {
+    int entry, j, node, r;
+
+    if (num_free[cls] == 0) {
+        return false;
+    }
+    entry = free_entries[cls][--num_free[cls]];
+    rs_wait_mask[entry] = 0;
+    dep_head[entry] = -1;
+
+    // fill Q for instruction
+    for (j = 0; j < 3; j++) {
+
+        // Q will copy the value in map table, which can be null if no tags
+        if (insn->r_in[j] != -1) {
+            r = insn->r_in[j];
+            insn->Q[j] = map_table[r];
+
+            // wait on the producer's broadcast
+            if (insn->Q[j] != NULL) {
+                node = entry * 3 + j;
+                rs_wait_mask[entry] |= 1 << j;
+                dep_next[node] = dep_head[map_entry[r]];
+                dep_head[map_entry[r]] = node;
             }
         }
     }
+
+    // edit map table
+    for (j = 0; j < 2; j++) {
+
+        if (insn->r_out[j] != -1) {
+            map_table[insn->r_out[j]] = insn;
+            map_entry[insn->r_out[j]] = entry;
+        }
+    }
+
+    // allocate the entry
+    reserv_of(cls)[entry - first_entry(cls)] = insn;
+    insn->tom_issue_cycle = current_cycle + 1;
+
+    // no operands to wait for, it can issue from next cycle on
+    if (rs_wait_mask[entry] == 0) {
+        make_ready(entry, 0);
+    }
+    return true;
 }
 
 
-void fetch_and_dispatch_To_issue(instruction_trace_t* trace, int current_cycle) {
-    
-    // fetch if IFQ is not full and we haven't reached the end of the trace
-    if (instr_queue_size < INSTR_QUEUE_SIZE && fetch_index <= sim_num_insn) {
-        
+/* ECE552 BEGIN */
+static bool can_fetch(int current_cycle) {
+    return mispred_branch == NULL && current_cycle >= fetch_resume_cycle;
+}
+
+// fetch has room and something to fetch, but is still paying a resolved mispredict's penalty
+static bool fetch_in_penalty(int current_cycle) {
+    return mispred_branch == NULL && current_cycle < fetch_resume_cycle &&
+           instr_queue_size < tom_ifq_size && fetch_index <= num_pushed;
+}
+
+// looks up and trains the predictor on a fetched control instruction, returns true if it mispredicted
+static bool predict_branch(instruction_t *insn) {
+    struct bpred_update_t update_rec;
+    int stack_idx;
+    md_inst_t inst = insn->inst;   //decoded by MD_IS_RETURN
+    md_addr_t fall_through = insn->pc + sizeof(md_inst_t);
+    md_addr_t pred_pc;
+
+    pred_pc = bpred_lookup(tom_bpred, insn->pc, insn->target_pc, insn->op,
+                           MD_IS_CALL(insn->op), MD_IS_RETURN(insn->op), &update_rec, &stack_idx);
+
+    // no predicted taken target, it falls through
+    if (!pred_pc) {
+        pred_pc = fall_through;
+    }
+
+    bpred_update(tom_bpred, insn->pc, insn->npc, insn->npc != fall_through,
+                 pred_pc != fall_through, pred_pc == insn->npc, insn->op, &update_rec);
+
+    return pred_pc != insn->npc;
+}
+/* ECE552 END */
+
+
+void fetch_and_dispatch_To_issue(int current_cycle) {
+    int w;
+
+    if (fetch_in_penalty(current_cycle)) {
+        tom_mispred_cycles++;
+    }
+
+    // fetch up to tom_dispatch_width instructions while the IFQ is not full and we haven't reached the end of the trace
+    for (w = 0; w < tom_dispatch_width && instr_queue_size < tom_ifq_size && fetch_index <= num_pushed && can_fetch(current_cycle); w++) {
+
         // fetch until valid instruction is fetched
-        while (1) {
-            instruction_t* fetched_instruction = get_instr(trace, fetch_index);
+        while (fetch_index <= num_pushed) {
+            instruction_t* fetched_instruction = window_instr(fetch_index);
             fetch_index++;
             // since F & D stages are combined, the instruction enters the dispatch stage the same stage it is fetched
             fetched_instruction->tom_dispatch_cycle = current_cycle;
-            
+
             enum md_opcode op = fetched_instruction->op;
-            
+
             // skip trap instructions, but count them towards instructions complete count
             if (IS_TRAP(op)) {
-                insn_complete++;
-            
+                complete(fetched_instruction);
+
             } else {
                 // place instruction in circular buffer
-                instr_queue[(IFQ_top + instr_queue_size) % INSTR_QUEUE_SIZE] = fetched_instruction;
+                instr_queue[(IFQ_top + instr_queue_size) % tom_ifq_size] = fetched_instruction;
                 instr_queue_size++;
+
+                // nothing behind a mispredicted branch is fetched until it resolves
+                if (tom_bpred && (IS_COND_CTRL(op) || IS_UNCOND_CTRL(op)) && predict_branch(fetched_instruction)) {
+                    mispred_branch = fetched_instruction;
+                }
                 // valid instruction, no more fetching
                 break;
             }
         }
     }
-    
-    instruction_t* top_instruction = instr_queue[IFQ_top];
-    
-    // if top instruction is null then the IFQ is empty and we can't dispatch
-    if (top_instruction == NULL) {
-        return;
-    }
-    
-    int i, j;
-    // if top instruction uses a integer FU
-    if (USES_INT_FU(top_instruction->op)) {
-        
-        // try to find an empty entry for it
-        for (i = 0; i < RESERV_INT_SIZE; i++) {
-            
-            if (reservINT[i] == NULL) {
-
-                // fill Q for instruction
-                for (j = 0; j < 3; j++) {
-                    
-                    // Q will copy the value in map table, which can be null if no tags
-                    if (top_instruction->r_in[j] != -1) {
-                        top_instruction->Q[j] = map_table[top_instruction->r_in[j]];
-                    }
-                }
-                
-                // edit map table
-                for (j = 0; j < 2; j++) {
-                    
-                    if (top_instruction->r_out[j] != -1) {
-                        map_table[top_instruction->r_out[j]] = top_instruction;
-                    }
-                }
-                
-                // allocate the entry
-                reservINT[i] = top_instruction;
-                top_instruction->tom_issue_cycle = current_cycle + 1;
-                
-                // remove the instruction from the IFQ
-                instr_queue[IFQ_top] = NULL;
-                IFQ_top = (IFQ_top + 1) % INSTR_QUEUE_SIZE;
-                instr_queue_size--;
-                
-                // can only disptach one instruction per cycle so exit loop
+
+    // dispatch in order from the top of the IFQ, stopping at the first instruction that can't go
+    for (w = 0; w < tom_dispatch_width; w++) {
+        instruction_t* top_instruction = instr_queue[IFQ_top];
+
+        // if top instruction is null then the IFQ is empty and we can't dispatch
+        if (top_instruction == NULL) {
+            return;
+        }
+
+        // with a ROB, every instruction needs an entry in it too
+        if (tom_rob_size > 0 && rob_count == tom_rob_size) {
+            return;
+        }
+
+        // if top instruction uses a integer FU
+        if (USES_INT_FU(top_instruction->op)) {
+
+            if (!dispatch_To_RS(top_instruction, CLASS_INT, current_cycle)) {
                 return;
             }
-        }
-    
-    // same as above but if top instruction is floating point
-    } else if (USES_FP_FU(top_instruction->op)) {
-        
-        for (i = 0; i < RESERV_FP_SIZE; i++) {
-            
-            if (reservFP[i] == NULL) {
-                
-                for (j = 0; j < 3; j++) {
-                    
-                    if (top_instruction->r_in[j] != -1) {
-                        top_instruction->Q[j] = map_table[top_instruction->r_in[j]];
-                    }
-                }
-                
-                for (j = 0; j < 2; j++) {
-                    
-                    if (top_instruction->r_out[j] != -1) {
-                        map_table[top_instruction->r_out[j]] = top_instruction;
-                    }
-                }
-                reservFP[i] = top_instruction;
-                instr_queue[IFQ_top] = NULL;
-                
-                IFQ_top = (IFQ_top + 1) % INSTR_QUEUE_SIZE;
-                instr_queue_size--;
-                top_instruction->tom_issue_cycle = current_cycle + 1;
-                
+
+        // same as above but if top instruction is floating point
+        } else if (USES_FP_FU(top_instruction->op)) {
+
+            if (!dispatch_To_RS(top_instruction, CLASS_FP, current_cycle)) {
                 return;
             }
+
+        // assume branch prediction is perfect and that control instructions don't use any FUs
+        } else if (IS_COND_CTRL(top_instruction->op) || IS_UNCOND_CTRL(top_instruction->op)) {
+            // the branch instruction is effectively complete after getting dispatched
+            finish(top_instruction, current_cycle);
+
+            // it resolves here, fetch restarts on the correct path after the penalty
+            if (top_instruction == mispred_branch) {
+                mispred_branch = NULL;
+                fetch_resume_cycle = current_cycle + 1 + tom_mispred_penalty;
+            }
+
+        } else {
+            return;
+        }
+
+        if (tom_rob_size > 0) {
+            rob[(rob_head + rob_count) % tom_rob_size] = top_instruction;
+            rob_count++;
         }
-    
-    // assume branch prediction is perfect and that control instructions don't use any FUs
-    } else if (IS_COND_CTRL(top_instruction->op) || IS_UNCOND_CTRL(top_instruction->op)) {
+
+        // remove the instruction from the IFQ
         instr_queue[IFQ_top] = NULL;
-        IFQ_top = (IFQ_top + 1) % INSTR_QUEUE_SIZE;
+        IFQ_top = (IFQ_top + 1) % tom_ifq_size;
         instr_queue_size--;
-        // the branch instruction is effectively complete after getting dispatched
-        insn_complete++;
     }
 }
 
 /* ECE552 Assignment 3 - END CODE */
 
 
-counter_t runTomasulo(instruction_trace_t* trace)
+/* ECE552 BEGIN */
+void commit_From_ROB(int current_cycle) {
+    int w;
+    instruction_t *insn;
+
+    // the store buffer writes its oldest store back to memory
+    if (sb_count > 0) {
+        sb_count--;
+    }
+
+    // commit up to tom_commit_width instructions in order, the cycle after they were done at the earliest
+    for (w = 0; w < tom_commit_width && rob_count > 0; w++) {
+        insn = rob[rob_head];
+
+        if (insn->tom_done_cycle == 0 || insn->tom_done_cycle >= current_cycle) {
+            return;
+        }
+
+        // a store commits by moving into the store buffer
+        if (IS_STORE(insn->op)) {
+            if (sb_count == tom_sb_size) {
+                tom_sb_full_cycles++;
+                return;
+            }
+            sb_count++;
+        }
+
+        rob[rob_head] = NULL;
+        rob_head = (rob_head + 1) % tom_rob_size;
+        rob_count--;
+        complete(insn);
+    }
+}
+/* ECE552 END */
+
+
+void startTomasulo(void)
 {
+  /* ECE552 BEGIN */
+  //allocate every structure at its configured size
+  instr_queue = (instruction_t **) calloc(tom_ifq_size, sizeof(instruction_t *));
+  reservINT = (instruction_t **) calloc(tom_rs_int_size, sizeof(instruction_t *));
+  reservFP = (instruction_t **) calloc(tom_rs_fp_size, sizeof(instruction_t *));
+  fuINT = (instruction_t **) calloc(tom_fu_int_size, sizeof(instruction_t *));
+  fuFP = (instruction_t **) calloc(tom_fu_fp_size, sizeof(instruction_t *));
+
+  int num_entries = tom_rs_int_size + tom_rs_fp_size;
+  rs_wait_mask = (int *) calloc(num_entries, sizeof(int));
+  rs_ready_cycle = (int *) calloc(num_entries, sizeof(int));
+  dep_head = (int *) calloc(num_entries, sizeof(int));
+  dep_next = (int *) calloc(3 * num_entries, sizeof(int));
+  ready_next = (int *) calloc(num_entries, sizeof(int));
+  free_entries[CLASS_INT] = (int *) calloc(tom_rs_int_size, sizeof(int));
+  free_entries[CLASS_FP] = (int *) calloc(tom_rs_fp_size, sizeof(int));
+  fuINT_entry = (int *) calloc(tom_fu_int_size, sizeof(int));
+  fuFP_entry = (int *) calloc(tom_fu_fp_size, sizeof(int));
+
+  if (!instr_queue || !reservINT || !reservFP || !fuINT || !fuFP ||
+      !rs_wait_mask || !rs_ready_cycle || !dep_head || !dep_next || !ready_next ||
+      !free_entries[CLASS_INT] || !free_entries[CLASS_FP] || !fuINT_entry || !fuFP_entry)
+    fatal("out of virtual memory");
+
+  //every entry starts free, the lowest ones on top
+  int e;
+  num_free[CLASS_INT] = 0;
+  for (e = tom_rs_int_size - 1; e >= 0; e--) {
+    free_entries[CLASS_INT][num_free[CLASS_INT]++] = e;
+  }
+  num_free[CLASS_FP] = 0;
+  for (e = num_entries - 1; e >= tom_rs_int_size; e--) {
+    free_entries[CLASS_FP][num_free[CLASS_FP]++] = e;
+  }
+  ready_head[CLASS_INT] = ready_head[CLASS_FP] = -1;
+
+  window = (instruction_t *) calloc(tom_window_size, sizeof(instruction_t));
+  rob = (instruction_t **) calloc(tom_rob_size > 0 ? tom_rob_size : 1, sizeof(instruction_t *));
+  if (!window || !rob)
+    fatal("out of virtual memory");
+
+  instr_queue_size = 0;
+  IFQ_top = 0;
+  insn_complete = 0;
+  fetch_index = 1;
+  num_pushed = 0;
+  pushing_done = false;
+  retire_index = 1;
+  cycle = 1;
+
+  rob_head = 0;
+  rob_count = 0;
+  sb_count = 0;
+  tom_rob_full_cycles = 0;
+  tom_sb_full_cycles = 0;
+
+  mispred_branch = NULL;
+  fetch_resume_cycle = 0;
+  tom_mispred_cycles = 0;
+
+  table_stream = NULL;
+  if (tom_table_file) {
+    table_stream = fopen(tom_table_file, "w");
+    if (!table_stream)
+      fatal("cannot open Tomasulo table file `%s'", tom_table_file);
+    fprintf(table_stream, "TOMASULO TABLE\n");
+  }
+  /* ECE552 END */
+
   //initialize instruction queue
   int i;
-  for (i = 0; i < INSTR_QUEUE_SIZE; i++) {
+  for (i = 0; i < tom_ifq_size; i++) {
     instr_queue[i] = NULL;
   }
 
   //initialize reservation stations
-  for (i = 0; i < RESERV_INT_SIZE; i++) {
+  for (i = 0; i < tom_rs_int_size; i++) {
       reservINT[i] = NULL;
   }
 
-  for(i = 0; i < RESERV_FP_SIZE; i++) {
+  for(i = 0; i < tom_rs_fp_size; i++) {
       reservFP[i] = NULL;
   }
 
   //initialize functional units
-  for (i = 0; i < FU_INT_SIZE; i++) {
+  for (i = 0; i < tom_fu_int_size; i++) {
     fuINT[i] = NULL;
   }
 
-  for (i = 0; i < FU_FP_SIZE; i++) {
+  for (i = 0; i < tom_fu_fp_size; i++) {
     fuFP[i] = NULL;
   }
 
@@ -542,24 +743,256 @@ counter_t runTomasulo(instruction_trace_t* trace)
   for (reg = 0; reg < MD_TOTAL_REGS; reg++) {
     map_table[reg] = NULL;
   }
-  
-  int cycle = 1;
-  while (true) {
-      /* ECE552 Assignment 3 - BEGIN CODE */
+}
+
+/* ECE552 BEGIN */
+
+// true once every instruction this cycle's fetch could take has been pushed
+static bool can_run_cycle(void) {
+  int room, k;
+
+  if (pushing_done)
+    return true;
+
+  // held behind a mispredict, fetch only needs to know whether there is anything to fetch
+  if (!can_fetch(cycle))
+    return instr_queue_size == tom_ifq_size || fetch_index <= num_pushed;
+
+  room = tom_dispatch_width < tom_ifq_size - instr_queue_size ?
+         tom_dispatch_width : tom_ifq_size - instr_queue_size;
+
+  // traps are skipped by fetch without using up the room
+  for (k = fetch_index; room > 0; k++) {
+    if (k > num_pushed)
+      return false;
+    if (!IS_TRAP(window_instr(k)->op))
+      room--;
+  }
+  return true;
+}
+
+// the earliest cycle from the current one on in which any stage can change state
+static int next_event_cycle(void) {
+  instruction_t *top = instr_queue[IFQ_top];
+  int next = INT_MAX, i, cls;
+
+  // waiting on the functional simulation to push more
+  if (instr_queue_size < tom_ifq_size && !pushing_done && fetch_index > num_pushed)
+    return cycle;
+
+  // fetch
+  if (instr_queue_size < tom_ifq_size && fetch_index <= num_pushed && mispred_branch == NULL) {
+    if (cycle >= fetch_resume_cycle)
+      return cycle;
+    next = fetch_resume_cycle;
+  }
+
+  // commit, or the store buffer writing back
+  if (sb_count > 0)
+    return cycle;
+  if (rob_count > 0 && rob[rob_head]->tom_done_cycle != 0 &&
+      (!IS_STORE(rob[rob_head]->op) || sb_count < tom_sb_size))
+    return cycle;
+
+  // dispatch
+  if (top != NULL && (tom_rob_size == 0 || rob_count < tom_rob_size)) {
+    if (IS_COND_CTRL(top->op) || IS_UNCOND_CTRL(top->op))
+      return cycle;
+    if ((USES_INT_FU(top->op) && num_free[CLASS_INT] > 0) ||
+        (USES_FP_FU(top->op) && num_free[CLASS_FP] > 0))
+      return cycle;
+  }
+
+  // issue into a free FU
+  for (cls = CLASS_INT; cls <= CLASS_FP; cls++) {
+    instruction_t **fu = cls == CLASS_INT ? fuINT : fuFP;
+    int fu_size = cls == CLASS_INT ? tom_fu_int_size : tom_fu_fp_size;
+
+    if (ready_head[cls] == -1)
+      continue;
+    for (i = 0; i < fu_size; i++) {
+      if (fu[i] == NULL)
+        return cycle;
+    }
+  }
+
+  // otherwise nothing moves until an FU finishes and frees its FU and RS entry
+  for (i = 0; i < tom_fu_int_size; i++) {
+    if (fuINT[i] != NULL && fuINT[i]->tom_execute_cycle + tom_fu_int_latency < next)
+      next = fuINT[i]->tom_execute_cycle + tom_fu_int_latency;
+  }
+  for (i = 0; i < tom_fu_fp_size; i++) {
+    if (fuFP[i] != NULL && fuFP[i]->tom_execute_cycle + tom_fu_fp_latency < next)
+      next = fuFP[i]->tom_execute_cycle + tom_fu_fp_latency;
+  }
+
+  return next == INT_MAX || next < cycle ? cycle : next;
+}
+
+static void run_cycle(void) {
+  instruction_t *insn;
+  int skip_to;
+  bool rob_blocked;
+
+  /* ECE552 Assignment 3 - BEGIN CODE */
+
+  // the stages have to be done in reverse order (C, X, DS) to create the illusion of synchronous pipeline operation
+  if (tom_rob_size > 0) {
+    commit_From_ROB(cycle);
+  }
+  execute_To_CDB(cycle);
+  issue_To_execute(cycle);
+  fetch_and_dispatch_To_issue(cycle);
+
+  /* ECE552 Assignment 3 - END CODE */
+
+  cycle++;
+
+  // the ROB is full with an instruction waiting to dispatch, after this cycle
+  // and, as nothing changes in them, after every skipped one
+  rob_blocked = tom_rob_size > 0 && rob_count == tom_rob_size && instr_queue[IFQ_top] != NULL;
+  if (rob_blocked) {
+    tom_rob_full_cycles++;
+  }
+
+  // skip the cycles in which nothing can happen, e.g. every FU busy on a long latency
+  skip_to = next_event_cycle();
+  if (rob_blocked) {
+    tom_rob_full_cycles += skip_to - cycle;
+  }
+  // a skip never passes fetch_resume_cycle while fetch has work, so the penalty lasts through it
+  if (fetch_in_penalty(cycle)) {
+    tom_mispred_cycles += skip_to - cycle;
+  }
+  cycle = skip_to;
 
-      // the stages have to be done in reverse order (C, X, DS) to create the illusion of synchronous pipeline operation
-      execute_To_CDB(cycle);
-      issue_To_execute(cycle);
-      fetch_and_dispatch_To_issue(trace, cycle);
+  // retire completed instructions from the window, in order
+  while (retire_index <= num_pushed && (insn = window_instr(retire_index))->tom_complete) {
+    if (table_stream)
+      fprint_tom_instr(table_stream, insn);
+    retire_index++;
+  }
+}
+
+// where an instruction still in flight sits after the window moved
+static instruction_t* moved(instruction_t *insn) {
+  return insn == NULL ? NULL : window_instr(insn->index);
+}
 
-      /* ECE552 Assignment 3 - END CODE */
+// doubles the window, moving the instructions in flight and every pointer to them
+static void grow_window(void) {
+  instruction_t *old = window;
+  instruction_t **waiting_on;
+  int old_size = tom_window_size;
+  int num_entries = tom_rs_int_size + tom_rs_fp_size;
+  int k, i, j, e;
+
+  window = (instruction_t *) calloc(2 * old_size, sizeof(instruction_t));
+  waiting_on = (instruction_t **) calloc(3 * num_entries, sizeof(instruction_t *));
+  if (!window || !waiting_on)
+    fatal("out of virtual memory");
+  tom_window_size = 2 * old_size;
+
+  for (k = retire_index; k <= num_pushed; k++) {
+    *window_instr(k) = old[k % old_size];
+  }
 
-      cycle++;
+  // moved() still reads the index through the old window until it is freed
+  for (i = 0; i < tom_ifq_size; i++) {
+    instr_queue[i] = moved(instr_queue[i]);
+  }
+  for (i = 0; i < tom_rs_int_size; i++) {
+    reservINT[i] = moved(reservINT[i]);
+  }
+  for (i = 0; i < tom_rs_fp_size; i++) {
+    reservFP[i] = moved(reservFP[i]);
+  }
+  for (i = 0; i < tom_fu_int_size; i++) {
+    fuINT[i] = moved(fuINT[i]);
+  }
+  for (i = 0; i < tom_fu_fp_size; i++) {
+    fuFP[i] = moved(fuFP[i]);
+  }
+  for (i = 0; i < MD_TOTAL_REGS; i++) {
+    map_table[i] = moved(map_table[i]);
+  }
+  for (i = 0; i < rob_count; i++) {
+    rob[(rob_head + i) % tom_rob_size] = moved(rob[(rob_head + i) % tom_rob_size]);
+  }
+  mispred_branch = moved(mispred_branch);
 
-      if (is_simulation_done(sim_num_insn)) 
-          break;
-      
-  } 
+  // Q only matters while its producer has not broadcast (and so is in
+  // flight); every other tag may name a retired instruction and is dropped
+  for (e = 0; e < num_entries; e++) {
+    instruction_t *insn = rs_insn(e);
+
+    for (j = 0; insn != NULL && j < 3; j++) {
+      if (rs_wait_mask[e] & (1 << j))
+        waiting_on[e * 3 + j] = moved(insn->Q[j]);
+    }
+  }
+  for (k = retire_index; k <= num_pushed; k++) {
+    for (j = 0; j < 3; j++) {
+      window_instr(k)->Q[j] = NULL;
+    }
+  }
+  for (e = 0; e < num_entries; e++) {
+    instruction_t *insn = rs_insn(e);
+
+    for (j = 0; insn != NULL && j < 3; j++) {
+      insn->Q[j] = waiting_on[e * 3 + j];
+    }
+  }
+
+  free(waiting_on);
+  free(old);
+}
+
+void pushTomasulo(instruction_t *instr)
+{
+  // the slot is free once the instruction tom_window_size older has retired
+  while (instr->index - retire_index >= tom_window_size) {
+    if (can_run_cycle())
+      run_cycle();
+    else
+      grow_window();
+  }
+
+  *window_instr(instr->index) = *instr;
+  num_pushed = instr->index;
+
+  while (can_run_cycle())
+    run_cycle();
+}
+
+counter_t finishTomasulo(void)
+{
+  pushing_done = true;
+
+  while (!is_simulation_done())
+    run_cycle();
+
+  free(instr_queue);
+  free(reservINT);
+  free(reservFP);
+  free(fuINT);
+  free(fuFP);
+  free(rs_wait_mask);
+  free(rs_ready_cycle);
+  free(dep_head);
+  free(dep_next);
+  free(ready_next);
+  free(free_entries[CLASS_INT]);
+  free(free_entries[CLASS_FP]);
+  free(fuINT_entry);
+  free(fuFP_entry);
+  free(window);
+  free(rob);
+
+  if (table_stream)
+    fclose(table_stream);
 
   return cycle;
 }
+
+/* ECE552 END */
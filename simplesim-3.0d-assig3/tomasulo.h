@@ -0,0 +1,45 @@
+
+#ifndef TOMASULO_H
+#define TOMASULO_H
+
+#include "host.h"
+#include "instr.h"
+#include "bpred.h"
+
+/* ECE552 BEGIN */
+
+/* PARAMETERS OF THE TOMASULO'S ALGORITHM, set by sim-safe's -tom:* options */
+
+extern int tom_ifq_size;         /* instruction fetch queue entries */
+extern int tom_rs_int_size;      /* integer reservation stations */
+extern int tom_rs_fp_size;       /* floating point reservation stations */
+extern int tom_fu_int_size;      /* integer functional units */
+extern int tom_fu_fp_size;       /* floating point functional units */
+extern int tom_fu_int_latency;   /* integer execute latency, cycles */
+extern int tom_fu_fp_latency;    /* floating point execute latency, cycles */
+extern int tom_dispatch_width;   /* instructions fetched and dispatched per cycle */
+extern int tom_num_cdbs;         /* results broadcast per cycle */
+
+extern int tom_rob_size;         /* reorder buffer entries, 0 for no ROB */
+extern int tom_commit_width;     /* instructions committed per cycle */
+extern int tom_sb_size;          /* store buffer entries */
+
+extern struct bpred_t *tom_bpred;  /* branch predictor, NULL for perfect prediction */
+extern int tom_mispred_penalty;  /* cycles to refetch after a mispredict resolves */
+
+extern int   tom_window_size;    /* instructions buffered between the functional and timing models, grows as needed */
+extern char* tom_table_file;     /* per-instruction timing table, NULL for none */
+
+extern counter_t tom_rob_full_cycles;  /* cycles ending with a full ROB and an instruction waiting to dispatch */
+extern counter_t tom_sb_full_cycles;   /* cycles commit stalled on a full store buffer */
+extern counter_t tom_mispred_cycles;   /* mispredict penalty cycles in which fetch had room and work */
+
+//the timing model runs alongside the functional simulation: start it, push
+//every executed instruction in order, and finish it to get the cycle count
+extern void      startTomasulo(void);
+extern void      pushTomasulo(instruction_t *instr);
+extern counter_t finishTomasulo(void);
+
+/* ECE552 END */
+
+#endif